@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hosttime.h"
+#include "perfcounters.h"
+#include "emulator.h"
+#include "movie.h"
+#include "state.h"
+#include "wide.h"
+
+// gb-bench: runs a fixed set of headless workloads and reports emulated
+// instructions per second, frames per second, speed over real time and a
+// host time breakdown per subsystem. Each workload runs twice, once plain
+// for the throughput numbers and once with gb_step_instruction_timed for the
+// breakdown, since the clock reads on sampled instructions slow it down.
+// With --perf the throughput pass is also measured with hardware counters.
+// --wide compares the lockstep interpreter in wide.h with gb_cpu_execute.
+
+#define BENCH_DEFAULT_FRAMES 600
+#define BENCH_ROM_SIZE 0x8000
+#define GB_FRAMES_PER_SECOND (4194304.0 / 70224.0)
+
+struct workload {
+    const char *name;
+    const char *description;
+    void (*setup)();
+    bool on_request; // Left out of the default set, only run with --workload
+};
+
+struct bench_result {
+    const char *name;
+    int frames;
+    uint64_t instructions;
+    uint64_t M_cycles;
+    double host_seconds;
+    double mips;
+    double fps;
+    double speed;
+    struct subsystem_times times;
+    uint64_t input_ns;
+    struct perf_counters counters;
+};
+
+uint8_t bench_rom[BENCH_ROM_SIZE];
+char *bench_rom_path = NULL;
+char *bench_movie_path = NULL;
+bool bench_perf = false;
+
+// Starts a ROM whose entry point jumps to program at 0x150
+void load_program(const uint8_t *program, int length) {
+    memset(bench_rom, 0, sizeof(bench_rom));
+    bench_rom[0x100] = 0x00;              // NOP
+    bench_rom[0x101] = 0xC3;              // JP 0x0150
+    bench_rom[0x102] = 0x50;
+    bench_rom[0x103] = 0x01;
+    memcpy(&bench_rom[0x150], program, length);
+    gb_init_memory_from_buffer(bench_rom, sizeof(bench_rom));
+    gb_init_cpu_registers();
+}
+
+// Register-only ALU loop with the LCD off
+void setup_cpu_loop() {
+    const uint8_t program[] = {
+        0x3E, 0x00, 0xE0, 0x40, // LD A,0 ; LDH [LCDC],A
+        0x04,                   // loop: INC B
+        0x88,                   // ADC A,B
+        0xA9,                   // XOR A,C
+        0x4F,                   // LD C,A
+        0x15,                   // DEC D
+        0xCB, 0x37,             // SWAP A
+        0x07,                   // RLCA
+        0x23,                   // INC HL
+        0x20, 0xF4,             // JR NZ,loop
+        0x18, 0xF2              // JR loop
+    };
+    load_program(program, sizeof(program));
+}
+
+// Idle CPU with background and 40 sprites enabled, all time goes to the PPU
+void setup_ppu_scene() {
+    const uint8_t program[] = {
+        0x3E, 0x93, 0xE0, 0x40, // LD A,0x93 ; LDH [LCDC],A (LCD, BG, OBJ on, tiles at 0x8000)
+        0x18, 0xFE              // loop: JR loop
+    };
+    load_program(program, sizeof(program));
+
+    for (int i = 0; i < 0x1800; i++)
+        gb_memory[0x8000 + i] = (i * 37) ^ (i >> 3);
+    for (int i = 0; i < 0x800; i++)
+        gb_memory[0x9800 + i] = i * 7;
+    for (int i = 0; i < 40; i++) {
+        gb_memory[0xFE00 + i*4] = 16 + (i * 4) % 144;     // Y
+        gb_memory[0xFE00 + i*4 + 1] = 8 + (i * 13) % 160; // X
+        gb_memory[0xFE00 + i*4 + 2] = i;                  // Tile
+        gb_memory[0xFE00 + i*4 + 3] = (i & 3) << 5;       // Flips
+    }
+}
+
+// Mostly HALT, like a game waiting for vblank every frame
+void setup_halt_loop() {
+    const uint8_t program[] = {
+        0x3E, 0x91, 0xE0, 0x40, // LD A,0x91 ; LDH [LCDC],A
+        0x76,                   // loop: HALT
+        0x00,                   // NOP
+        0x18, 0xFC              // JR loop
+    };
+    load_program(program, sizeof(program));
+}
+
+// MBC bank register writes interleaved with switchable bank reads. There's
+// no MBC yet, so this only runs when asked for.
+void setup_bank_switch() {
+    const uint8_t program[] = {
+        0x3E, 0x91, 0xE0, 0x40, // LD A,0x91 ; LDH [LCDC],A
+        0x3E, 0x01,             // loop: LD A,1
+        0xEA, 0x00, 0x20,       // LD [0x2000],A
+        0xFA, 0x00, 0x40,       // LD A,[0x4000]
+        0x3E, 0x02,             // LD A,2
+        0xEA, 0x00, 0x20,       // LD [0x2000],A
+        0xFA, 0x00, 0x60,       // LD A,[0x6000]
+        0x18, 0xEE              // JR loop
+    };
+    load_program(program, sizeof(program));
+}
+
+bool setup_rom_file() {
+    if (!gb_init_memory(bench_rom_path))
+        return false;
+    gb_init_cpu_registers();
+    return bench_movie_path == NULL || movie_start_playback(bench_movie_path);
+}
+
+void setup_rom() {
+    if (!setup_rom_file()) {
+        fprintf(stderr, "Could not set up %s\n", bench_rom_path);
+        exit(1);
+    }
+}
+
+struct workload workloads[] = {
+    {"cpu-loop", "register ALU loop, LCD off", setup_cpu_loop},
+    {"ppu-scene", "background and 40 sprites, idle CPU", setup_ppu_scene},
+    {"halt-loop", "HALT waiting loop", setup_halt_loop},
+    {"bank-switch", "bank register writes and bank reads", setup_bank_switch, true},
+};
+
+// Register loop whose branches depend on per-lane data. Each outer
+// iteration stores to WRAM, which runs wide, then reads LY and stores to
+// VRAM, which the wide interpreter leaves to gb_cpu_execute
+void setup_wide_loop() {
+    const uint8_t program[] = {
+        0x21, 0x00, 0xC0,       // LD HL,0xC000
+        0x04,                   // loop: INC B
+        0xA8,                   // XOR A,B
+        0x4F,                   // LD C,A
+        0xA3,                   // AND A,E
+        0xB1,                   // OR A,C
+        0xB8,                   // CP A,B
+        0x28, 0x02,             // JR Z,skip
+        0x1C,                   // INC E
+        0x1C,                   // INC E
+        0x23,                   // skip: INC HL
+        0x15,                   // DEC D
+        0x20, 0xF2,             // JR NZ,loop
+        0xEA, 0x00, 0xC0,       // LD [0xC000],A
+        0xF0, 0x44,             // LDH A,[LY]
+        0xEA, 0x00, 0x98,       // LD [0x9800],A
+        0x16, 0x20,             // LD D,0x20
+        0x18, 0xE6              // JR loop
+    };
+    load_program(program, sizeof(program));
+}
+
+bool lanes_match(struct wide_batch *a, struct wide_batch *b, int l) {
+    return a->A[l] == b->A[l] && a->F[l] == b->F[l] && a->B[l] == b->B[l] && a->C[l] == b->C[l]
+        && a->D[l] == b->D[l] && a->E[l] == b->E[l] && a->H[l] == b->H[l] && a->L[l] == b->L[l]
+        && a->SP[l] == b->SP[l] && a->PC[l] == b->PC[l] && a->M_cycles[l] == b->M_cycles[l]
+        && memcmp(a->ram[l], b->ram[l], WIDE_RAM_SIZE) == 0;
+}
+
+// Runs every lane for the same number of instructions through gb_cpu_execute
+// one lane at a time, then through wide_step, and checks both agree
+bool run_wide_check(int steps) {
+    struct wide_batch *reference = calloc(1, sizeof(struct wide_batch));
+    struct wide_batch *batch = calloc(1, sizeof(struct wide_batch));
+    reference->resident = -1;
+    gb_reset_emulator();
+    setup_wide_loop();
+    for (int l = 0; l < WIDE_LANES; l++) {
+        gb_cpu.B = l * 37;
+        gb_cpu.D = 0x20;
+        gb_cpu.E = l * 11;
+        wide_store_lane(reference, l);
+    }
+    *batch = *reference;
+
+    uint64_t start = gb_host_time_ns();
+    for (int l = 0; l < WIDE_LANES; l++) {
+        wide_load_lane(reference, l);
+        for (int i = 0; i < steps; i++) {
+            uint16_t opcode = gb_memory[gb_cpu.PC];
+            if (opcode == 0xCB)
+                opcode = (opcode << 8) | gb_memory[gb_cpu.PC+1];
+            reference->M_cycles[l] += gb_cpu_execute(opcode);
+        }
+        wide_store_lane(reference, l);
+    }
+    double scalar_seconds = (gb_host_time_ns() - start) / 1e9;
+
+    start = gb_host_time_ns();
+    for (int i = 0; i < steps; i++)
+        wide_step(batch);
+    wide_flush(batch);
+    double wide_seconds = (gb_host_time_ns() - start) / 1e9;
+
+    bool match = true;
+    for (int l = 0; l < WIDE_LANES; l++)
+        match &= lanes_match(reference, batch, l);
+
+    uint64_t total = (uint64_t)steps * WIDE_LANES;
+    printf("wide: %d lanes x %d instructions, scalar %.2f MIPS, wide %.2f MIPS (%.2fx)\n",
+        WIDE_LANES, steps, total / scalar_seconds / 1e6, total / wide_seconds / 1e6, scalar_seconds / wide_seconds);
+    printf("wide: %.1f%% of lane instructions ran wide, %.1f lanes per wide group, results %s\n",
+        100.0 * batch->wide_instructions / total, (double)batch->wide_instructions / (batch->groups ? batch->groups : 1),
+        match ? "match gb_cpu_execute" : "DIFFER from gb_cpu_execute");
+    free(reference);
+    free(batch);
+    return match;
+}
+
+uint64_t timer_overhead_ns() {
+    uint64_t start = gb_host_time_ns();
+    for (int i = 0; i < 10000; i++)
+        gb_host_time_ns();
+    return (gb_host_time_ns() - start) / 10000;
+}
+
+uint64_t subtract_overhead(uint64_t ns, uint64_t overhead) {
+    return ns > overhead ? ns - overhead : 0;
+}
+
+void run_workload(struct workload *workload, int frames, struct bench_result *result) {
+    memset(result, 0, sizeof(*result));
+    result->name = workload->name;
+    result->frames = frames;
+
+    // Throughput pass
+    gb_reset_emulator();
+    workload->setup();
+    bool counting = bench_perf && perf_counters_open(&result->counters);
+    if (counting)
+        perf_counters_start(&result->counters);
+    uint64_t start = gb_host_time_ns();
+    for (int frame = 0; frame < frames; frame++) {
+        movie_frame_input();
+        gb_run_frame();
+    }
+    uint64_t elapsed = gb_host_time_ns() - start;
+    if (counting) {
+        perf_counters_stop(&result->counters);
+        perf_counters_close(&result->counters);
+    }
+    movie_stop();
+
+    result->instructions = gb_instruction_counter;
+    result->M_cycles = gb_total_M_cycles;
+    result->host_seconds = elapsed / 1e9;
+    result->mips = gb_instruction_counter / result->host_seconds / 1e6;
+    result->fps = frames / result->host_seconds;
+    result->speed = result->fps / GB_FRAMES_PER_SECOND;
+
+    // Breakdown pass
+    gb_reset_emulator();
+    workload->setup();
+    uint64_t overhead = timer_overhead_ns();
+    for (int frame = 0; frame < frames; frame++) {
+        uint64_t input_start = gb_host_time_ns();
+        movie_frame_input();
+        result->input_ns += gb_host_time_ns() - input_start;
+        gb_run_frame_timed(&result->times);
+    }
+    movie_stop();
+
+    gb_subtract_clock_overhead(&result->times);
+    result->input_ns = subtract_overhead(result->input_ns, overhead * frames);
+}
+
+uint64_t attributed_ns(struct bench_result *result) {
+    return result->times.cpu_ns + result->times.interrupts_ns + result->times.ppu_ns + result->input_ns;
+}
+
+// Share of the attributed time, the clock reads themselves are left out
+double percent(uint64_t part, struct bench_result *result) {
+    uint64_t whole = attributed_ns(result);
+    return whole ? 100.0 * part / whole : 0;
+}
+
+void print_counters(struct bench_result *r) {
+    printf("%-14s", r->name);
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (r->counters.available[i])
+            printf(" %11.0f %7.3f", (double)r->counters.values[i] / r->frames,
+                (double)r->counters.values[i] / r->instructions);
+        else
+            printf(" %11s %7s", "n/a", "n/a");
+    }
+    printf("\n");
+}
+
+void write_json(FILE *out, struct bench_result *results, int count) {
+    fprintf(out, "{\n  \"compiler\": \"%s\",\n  \"workloads\": [\n", __VERSION__);
+    for (int i = 0; i < count; i++) {
+        struct bench_result *r = &results[i];
+        fprintf(out, "    {\n");
+        fprintf(out, "      \"name\": \"%s\",\n", r->name);
+        fprintf(out, "      \"frames\": %d,\n", r->frames);
+        fprintf(out, "      \"instructions\": %llu,\n", (unsigned long long)r->instructions);
+        fprintf(out, "      \"m_cycles\": %llu,\n", (unsigned long long)r->M_cycles);
+        fprintf(out, "      \"host_seconds\": %.6f,\n", r->host_seconds);
+        fprintf(out, "      \"mips\": %.3f,\n", r->mips);
+        fprintf(out, "      \"fps\": %.2f,\n", r->fps);
+        fprintf(out, "      \"speed\": %.3f,\n", r->speed);
+        if (bench_perf) {
+            fprintf(out, "      \"counters\": {\n");
+            for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+                fprintf(out, "        \"%s\": ", perf_counter_names[c]);
+                if (r->counters.available[c])
+                    fprintf(out, "{\"total\": %llu, \"per_frame\": %.1f, \"per_instruction\": %.4f}",
+                        (unsigned long long)r->counters.values[c], (double)r->counters.values[c] / r->frames,
+                        (double)r->counters.values[c] / r->instructions);
+                else
+                    fprintf(out, "null");
+                fprintf(out, "%s\n", c + 1 < PERF_COUNTER_COUNT ? "," : "");
+            }
+            fprintf(out, "      },\n");
+        }
+        fprintf(out, "      \"breakdown_ns\": {\n");
+        fprintf(out, "        \"cpu_execute\": %llu,\n", (unsigned long long)r->times.cpu_ns);
+        fprintf(out, "        \"ppu_execute\": %llu,\n", (unsigned long long)r->times.ppu_ns);
+        fprintf(out, "        \"handle_interrupts\": %llu,\n", (unsigned long long)r->times.interrupts_ns);
+        fprintf(out, "        \"input\": %llu\n", (unsigned long long)r->input_ns);
+        fprintf(out, "      }\n");
+        fprintf(out, "    }%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+    int frames = BENCH_DEFAULT_FRAMES;
+    char *json_path = NULL;
+    char *only = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i+1 < argc)
+            frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i+1 < argc)
+            json_path = argv[++i];
+        else if (strcmp(argv[i], "--workload") == 0 && i+1 < argc)
+            only = argv[++i];
+        else if (strcmp(argv[i], "--rom") == 0 && i+1 < argc)
+            bench_rom_path = argv[++i];
+        else if (strcmp(argv[i], "--movie") == 0 && i+1 < argc)
+            bench_movie_path = argv[++i];
+        else if (strcmp(argv[i], "--perf") == 0)
+            bench_perf = true;
+        else if (strcmp(argv[i], "--wide") == 0)
+            return run_wide_check(frames * 10000) ? 0 : 1;
+        else {
+            fprintf(stderr, "usage: gb-bench [--frames N] [--json out.json] [--workload name] [--perf] [--wide] [--rom game.gb [--movie run.gbm]]\n");
+            return 1;
+        }
+    }
+
+    struct workload rom_workload = {"rom", "ROM file", setup_rom};
+    struct workload *selected[8];
+    int count = 0;
+    if (bench_rom_path) {
+        rom_workload.name = bench_rom_path;
+        selected[count++] = &rom_workload;
+    }
+    else {
+        for (int i = 0; i < (int)(sizeof(workloads) / sizeof(workloads[0])); i++) {
+            if (only ? strcmp(only, workloads[i].name) == 0 : !workloads[i].on_request)
+                selected[count++] = &workloads[i];
+        }
+    }
+    if (count == 0) {
+        fprintf(stderr, "Unknown workload %s\n", only);
+        return 1;
+    }
+
+    struct bench_result results[8];
+    printf("%-14s %7s %13s %8s %9s %8s %7s %7s %7s %7s\n",
+        "workload", "frames", "instructions", "MIPS", "fps", "speed", "cpu%", "ppu%", "irq%", "input%");
+    for (int i = 0; i < count; i++) {
+        struct bench_result *r = &results[i];
+        run_workload(selected[i], frames, r);
+        printf("%-14s %7d %13llu %8.2f %9.1f %7.1fx %6.1f%% %6.1f%% %6.1f%% %6.1f%%\n",
+            r->name, r->frames, (unsigned long long)r->instructions, r->mips, r->fps, r->speed,
+            percent(r->times.cpu_ns, r), percent(r->times.ppu_ns, r),
+            percent(r->times.interrupts_ns, r), percent(r->input_ns, r));
+    }
+
+    if (bench_perf) {
+        // Host counters per emulated frame and per guest instruction
+        printf("\n%-14s", "per frame/instr");
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+            printf(" %19s", perf_counter_names[c]);
+        printf("\n");
+        for (int i = 0; i < count; i++)
+            print_counters(&results[i]);
+    }
+
+    if (json_path) {
+        FILE *out = fopen(json_path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Could not write %s!\n", json_path);
+            return 1;
+        }
+        write_json(out, results, count);
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,534 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "state.h"
+#include "gbenv.h"
+#include "snapshot.h"
+#include "observe.h"
+#include "movie.h"
+#include "link.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+// gb-check: asserts properties of the headers that only library users
+// reach, on small generated programs. Every check prints one line and the
+// exit status is 0 only if all of them held.
+//   env       gbenv.h gives the same observations and rewards with forked
+//             workers as in one process, across resets
+//   snapshot  snapshot.h trees restore exactly the state each node saved,
+//             after their parent is freed, and children share their pages
+//   observe   observe.h gives the same gray, crop, downsample and stack output
+//             as a direct computation, whichever kernels it was built with
+//   movie     movie.h plays back the exact state it recorded, with buttons
+//             pressed and released within a frame
+//   link      link.h pairs exchange every byte in strict and relaxed mode, and
+//             a process whose peer died without closing the link carries on
+
+#define CHECK_ROM_SIZE 0x8000
+#define CHECK_ENV_INSTANCES 7
+#define CHECK_SNAPSHOT_CHILDREN 16
+#define CHECK_MOVIE_FRAMES 120
+#define CHECK_LINK_BYTES 16
+#define CHECK_LINK_FRAMES 30
+
+uint8_t check_rom[CHECK_ROM_SIZE];
+uint32_t check_random_state = 1;
+
+uint32_t check_random() {
+    check_random_state = check_random_state * 1103515245 + 12345;
+    return check_random_state >> 16;
+}
+
+// A ROM whose entry point jumps to program at 0x150
+void build_rom(const uint8_t *program, int length) {
+    memset(check_rom, 0, sizeof(check_rom));
+    check_rom[0x100] = 0x00;              // NOP
+    check_rom[0x101] = 0xC3;              // JP 0x0150
+    check_rom[0x102] = 0x50;
+    check_rom[0x103] = 0x01;
+    memcpy(&check_rom[0x150], program, length);
+}
+
+// Once per frame, while Right is held, counts up 0xC100 and moves sprite 0
+// to that X, so rewards and observations depend on the input
+void build_input_rom() {
+    const uint8_t program[] = {
+        0x3E, 0x93, 0xE0, 0x40, // LD A,0x93 ; LDH [LCDC],A (LCD, BG, OBJ on)
+        0xF0, 0x44,             // loop: LDH A,[LY]
+        0xFE, 0x90,             // CP 144
+        0x20, 0xFA,             // JR NZ,loop
+        0x3E, 0x20, 0xE0, 0x00, // LD A,0x20 ; LDH [P1],A (select the d-pad)
+        0xF0, 0x00,             // LDH A,[P1]
+        0xE6, 0x01,             // AND 1 (Right, 0 when held)
+        0x20, 0x0A,             // JR NZ,released
+        0xFA, 0x00, 0xC1,       // LD A,[0xC100]
+        0x3C,                   // INC A
+        0xEA, 0x00, 0xC1,       // LD [0xC100],A
+        0xEA, 0x01, 0xFE,       // LD [0xFE01],A
+        0xF0, 0x44,             // released: LDH A,[LY]
+        0xFE, 0x90,             // CP 144
+        0x28, 0xFA,             // JR Z,released
+        0x18, 0xDE              // JR loop
+    };
+    build_rom(program, sizeof(program));
+}
+
+// Counts joypad interrupt requests in 0xC100 by polling IF, with both
+// button groups selected
+void build_joypad_rom() {
+    const uint8_t program[] = {
+        0x3E, 0x91, 0xE0, 0x40, // LD A,0x91 ; LDH [LCDC],A (LCD, BG on)
+        0x3E, 0x00, 0xE0, 0x00, // LD A,0 ; LDH [P1],A (select both groups)
+        0xF0, 0x0F,             // loop: LDH A,[IF]
+        0xE6, 0x10,             // AND 0x10
+        0x28, 0xFA,             // JR Z,loop
+        0xFA, 0x00, 0xC1,       // LD A,[0xC100]
+        0x3C,                   // INC A
+        0xEA, 0x00, 0xC1,       // LD [0xC100],A
+        0xF0, 0x0F,             // LDH A,[IF]
+        0xE6, 0xEF,             // AND 0xEF
+        0xE0, 0x0F,             // LDH [IF],A
+        0x18, 0xEB              // JR loop
+    };
+    build_rom(program, sizeof(program));
+}
+
+// Sends CHECK_LINK_BYTES bytes counting up from first over the link with
+// the given SC, after a busy wait of delay, and stores the bytes received
+// at 0xC000. The master clocks (SC 0x81), the slave waits longer and
+// listens (SC 0x80), so the master's transfers arrive while it's busy.
+void build_link_rom(uint8_t first, uint8_t sc, uint8_t delay) {
+    const uint8_t program[] = {
+        0x21, 0x00, 0xC0,       // LD HL,0xC000
+        0x06, first,            // LD B,first
+        0x0E, delay,            // loop: LD C,delay
+        0x0D,                   // wait: DEC C
+        0x20, 0xFD,             // JR NZ,wait
+        0x78, 0xE0, 0x01,       // LD A,B ; LDH [SB],A
+        0x3E, sc, 0xE0, 0x02,   // LD A,sc ; LDH [SC],A
+        0xF0, 0x02,             // busy: LDH A,[SC]
+        0xE6, 0x80,             // AND 0x80
+        0x20, 0xFA,             // JR NZ,busy
+        0xF0, 0x01,             // LDH A,[SB]
+        0x22,                   // LD [HL+],A
+        0x04, 0x78,             // INC B ; LD A,B
+        0xFE, first + CHECK_LINK_BYTES, // CP first+CHECK_LINK_BYTES
+        0x20, 0xE5,             // JR NZ,loop
+        0x18, 0xFE              // JR $
+    };
+    build_rom(program, sizeof(program));
+}
+
+void boot_check_rom() {
+    gb_reset_emulator();
+    gb_init_memory_from_buffer(check_rom, sizeof(check_rom));
+    gb_init_cpu_registers();
+}
+
+#ifndef _WIN32
+// gb_env_create takes a path, so the ROM goes through a temporary file
+bool write_check_rom(char *path) {
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return false;
+    bool written = write(fd, check_rom, sizeof(check_rom)) == sizeof(check_rom);
+    close(fd);
+    return written;
+}
+
+bool check_env() {
+    const int count = CHECK_ENV_INSTANCES, steps = 120;
+    char path[] = "/tmp/gb-check-XXXXXX";
+    build_input_rom();
+    if (!write_check_rom(path)) {
+        printf("env: could not write a ROM to /tmp\n");
+        return false;
+    }
+    struct gb_env *local = gb_env_create(path, count, 2, 2, 1);
+    struct gb_env *forked = gb_env_create(path, count, 2, 2, 3);
+    unlink(path);
+    if (local == NULL || forked == NULL) {
+        printf("env: could not create the environments\n");
+        return false;
+    }
+    gb_env_add_reward(local, 0xC100, 1, 1.0f, true);
+    gb_env_add_reward(forked, 0xC100, 1, 1.0f, true);
+
+    int size = gb_env_observation_size(local);
+    uint8_t *observations = malloc((size_t)count * size);
+    uint8_t actions[CHECK_ENV_INSTANCES];
+    float local_rewards[CHECK_ENV_INSTANCES], forked_rewards[CHECK_ENV_INSTANCES];
+    double total_reward = 0;
+    int mismatch = -1;
+    check_random_state = 1;
+    for (int step = 0; step < steps && mismatch < 0; step++) {
+        for (int i = 0; i < count; i++)
+            actions[i] = check_random() % 3 ? BUTTON_RIGHT : 0;
+        if (step == 40) {
+            gb_env_reset(local, 3, NULL);
+            gb_env_reset(forked, 3, NULL);
+        }
+        if (step == 80) {
+            gb_env_reset(local, -1, NULL);
+            gb_env_reset(forked, -1, NULL);
+        }
+        if (!gb_env_step(local, actions, observations, local_rewards)
+            || !gb_env_step(forked, actions, NULL, forked_rewards)) {
+            printf("env: step %d failed\n", step);
+            return false;
+        }
+        if (memcmp(local_rewards, forked_rewards, sizeof(local_rewards)) != 0
+            || memcmp(observations, gb_env_observations(forked), (size_t)count * size) != 0)
+            mismatch = step;
+        for (int i = 0; i < count; i++)
+            total_reward += local_rewards[i];
+    }
+    // Instances that held Right for different frames must look different
+    bool distinct = memcmp(observations, observations + size, size) != 0;
+    gb_env_destroy(local);
+    gb_env_destroy(forked);
+    free(observations);
+
+    bool ok = mismatch < 0 && total_reward > 0 && distinct;
+    if (mismatch >= 0)
+        printf("env: 3 workers differ from one process at step %d\n", mismatch);
+    else
+        printf("env: %d instances x %d steps, 3 workers match one process, total reward %.0f, %s\n",
+            count, steps, total_reward, distinct ? "observations differ between instances" : "observations ALL EQUAL");
+    return ok;
+}
+
+// Records random button events, several per frame at times, folded into one
+// mask per frame the way the frontend does, then plays the movie back
+bool check_movie() {
+    char path[] = "/tmp/gb-check-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("movie: could not create a file in /tmp\n");
+        return false;
+    }
+    close(fd);
+    build_joypad_rom();
+    boot_check_rom();
+    if (!movie_start_recording(path)) {
+        unlink(path);
+        return false;
+    }
+    check_random_state = 7;
+    int taps = 0;
+    for (int frame = 0; frame < CHECK_MOVIE_FRAMES; frame++) {
+        uint8_t buttons = gb_joypad_buttons, pressed_now = 0;
+        int events = check_random() % 4;
+        for (int e = 0; e < events; e++) {
+            uint8_t button = 1 << (check_random() % 8);
+            bool pressed = check_random() % 2;
+            buttons = pressed ? buttons | button : buttons & ~button;
+            pressed_now = pressed ? pressed_now | button : pressed_now;
+        }
+        // Pressed and released again before the frame ran
+        if (pressed_now & ~buttons)
+            taps++;
+        gb_set_joypad_buttons(buttons);
+        movie_frame_input();
+        gb_run_frame();
+    }
+    movie_stop();
+    struct gb_state *states = calloc(2, sizeof(struct gb_state));
+    gb_save_state(&states[0]);
+    int interrupts = gb_memory[0xC100];
+
+    boot_check_rom();
+    bool played = movie_start_playback(path);
+    unlink(path);
+    int frames = 0;
+    while (played && !movie_finished()) {
+        movie_frame_input();
+        gb_run_frame();
+        frames++;
+    }
+    movie_stop();
+    gb_save_state(&states[1]);
+    bool same = memcmp(&states[0], &states[1], sizeof(struct gb_state)) == 0;
+    free(states);
+
+    if (!played || frames != CHECK_MOVIE_FRAMES)
+        printf("movie: played back %d of %d frames\n", frames, CHECK_MOVIE_FRAMES);
+    else
+        printf("movie: %d frames with %d taps within a frame, %d joypad interrupts, playback %s\n",
+            frames, taps, interrupts, same ? "matches the recording" : "DIFFERS from the recording");
+    return played && frames == CHECK_MOVIE_FRAMES && same && interrupts > 0;
+}
+
+// Whether the 16 bytes at 0xC000 count up from first, or are all 0xFF for
+// a peer that was gone
+bool link_bytes_are(uint8_t first) {
+    for (int i = 0; i < CHECK_LINK_BYTES; i++) {
+        if (gb_memory[0xC000 + i] != (first == 0xFF ? 0xFF : first + i))
+            return false;
+    }
+    return true;
+}
+
+bool check_link() {
+    char paths[2][32] = {"/tmp/gb-check-XXXXXX", "/tmp/gb-check-XXXXXX"};
+    char *roms[2] = {paths[0], paths[1]};
+    build_link_rom(0x00, 0x81, 0x00);
+    bool written = write_check_rom(paths[0]);
+    build_link_rom(0x80, 0x80, 0x40);
+    written &= write_check_rom(paths[1]);
+    if (!written) {
+        printf("link: could not write the ROMs to /tmp\n");
+        return false;
+    }
+
+    bool ok = true;
+    for (int relaxed = 0; relaxed < 2; relaxed++) {
+        struct link_pair *pair = link_pair_create(roms, relaxed);
+        if (pair == NULL) {
+            ok = false;
+            break;
+        }
+        for (int frame = 0; frame < CHECK_LINK_FRAMES; frame++)
+            link_pair_run(pair, gb_total_dots_per_frame / 4);
+        link_pair_select(pair, 0);
+        bool master = link_bytes_are(0x80);
+        link_pair_select(pair, 1);
+        bool slave = link_bytes_are(0x00);
+        printf("link: %s pair, %llu transfers, master %s, slave %s\n", relaxed ? "relaxed" : "strict",
+            (unsigned long long)(pair->endpoints[0].transfers + pair->endpoints[1].transfers),
+            master ? "received every byte" : "MISSED bytes", slave ? "received every byte" : "MISSED bytes");
+        ok &= master && slave;
+        link_pair_destroy(pair);
+    }
+
+    // Side 1 attaches and exits without closing, side 0 must run on alone
+    char name[64];
+    snprintf(name, sizeof(name), "gb-check-link-%d", (int)getpid());
+    gb_reset_emulator();
+    bool opened = gb_init_memory(roms[0]) && link_open_shared(name, false);
+    gb_init_cpu_registers();
+    pid_t peer = -1;
+    int status = 0;
+    if (opened) {
+        fflush(stdout);
+        peer = fork();
+        if (peer == 0)
+            _exit(link_open_shared(name, false) ? 0 : 1);
+    }
+    bool attached = peer > 0 && waitpid(peer, &status, 0) == peer && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    bool alone = false;
+    if (attached) {
+        alarm(10); // A side still waiting for the dead one never returns
+        for (int frame = 0; frame < CHECK_LINK_FRAMES; frame++)
+            link_run_frame();
+        alarm(0);
+        alone = link_bytes_are(0xFF);
+    }
+    link_close_shared();
+    unlink(paths[0]);
+    unlink(paths[1]);
+    if (!attached)
+        printf("link: could not connect two processes through %s\n", name);
+    else
+        printf("link: side 0 %s after side 1 died\n", alone ? "ran on and read 0xFF" : "read UNEXPECTED bytes");
+    return ok && attached && alone;
+}
+#else
+bool check_env() {
+    printf("env: forked workers need POSIX, skipped\n");
+    return true;
+}
+
+bool check_movie() {
+    printf("movie: needs mkstemp, skipped\n");
+    return true;
+}
+
+bool check_link() {
+    printf("link: needs mkstemp and fork, skipped\n");
+    return true;
+}
+#endif
+
+// Children run from the root with Right held for a different number of
+// frames, every other one gets a grandchild that runs further
+bool check_snapshot() {
+    struct gb_snapshot *nodes[2 * CHECK_SNAPSHOT_CHILDREN];
+    struct gb_state *expected = calloc(2 * CHECK_SNAPSHOT_CHILDREN, sizeof(struct gb_state));
+    struct gb_state *actual = calloc(1, sizeof(struct gb_state));
+    build_input_rom();
+    boot_check_rom();
+    for (int frame = 0; frame < 10; frame++)
+        gb_run_frame();
+    struct gb_snapshot *root = gb_snapshot_create();
+
+    int count = 0;
+    size_t largest_child = 0;
+    for (int k = 0; k < CHECK_SNAPSHOT_CHILDREN; k++) {
+        gb_snapshot_load(root);
+        struct gb_snapshot *child = gb_clone(root);
+        for (int frame = 0; frame < 60; frame++) {
+            gb_set_joypad_buttons(frame < k * 3 ? BUTTON_RIGHT : 0);
+            gb_run_frame();
+        }
+        gb_snapshot_save(child);
+        gb_save_state(&expected[count]);
+        nodes[count++] = child;
+        if (k % 2 == 0) {
+            struct gb_snapshot *grandchild = gb_clone(child);
+            gb_set_joypad_buttons(BUTTON_RIGHT);
+            for (int frame = 0; frame < 30; frame++)
+                gb_run_frame();
+            gb_snapshot_save(grandchild);
+            gb_save_state(&expected[count]);
+            nodes[count++] = grandchild;
+        }
+        size_t bytes = gb_snapshot_private_bytes(child);
+        if (bytes > largest_child)
+            largest_child = bytes;
+    }
+    gb_snapshot_free(root);
+
+    // Restored out of order, so no state is left over from the previous one
+    int wrong = -1;
+    for (int i = 0; i < count && wrong < 0; i++) {
+        int node = (i * 7) % count;
+        gb_snapshot_load(nodes[node]);
+        gb_save_state(actual);
+        if (memcmp(actual, &expected[node], sizeof(struct gb_state)) != 0)
+            wrong = node;
+    }
+    for (int i = 0; i < count; i++)
+        gb_snapshot_free(nodes[i]);
+    free(expected);
+    free(actual);
+
+    // A full copy of memory and the frame buffer is about 100 pages
+    bool shared = largest_child < sizeof(struct gb_snapshot) + 32 * sizeof(struct snapshot_page);
+    if (wrong >= 0)
+        printf("snapshot: node %d restored a different state than it saved\n", wrong);
+    else
+        printf("snapshot: %d nodes restored exactly after freeing the root, largest child owns %zu bytes%s\n",
+            count, largest_child, shared ? "" : ", TOO MANY unshared pages");
+    return wrong < 0 && shared;
+}
+
+// The shade the LCD shows for a color index, spelled out independently of
+// observe_palette
+int reference_gray(uint8_t bgp, int index) {
+    static const int shades[4] = {255, 170, 85, 0};
+    return shades[(bgp >> (index * 2)) & 3];
+}
+
+bool check_observe() {
+    const uint8_t palettes[] = {0xE4, 0x1B, 0x00, 0xFF, 0x93, 0x6C};
+    // Crops with odd offsets and widths reach the scalar tail after the
+    // 16-byte blocks
+    const int crops[][4] = {{0, 0, 160, 144}, {3, 5, 37, 11}, {144, 100, 16, 44}, {1, 143, 159, 1}};
+    static uint8_t out[SCR_WIDTH * SCR_HEIGHT], expected[SCR_WIDTH * SCR_HEIGHT];
+    const char *failed = NULL;
+    int fill = 0;
+    check_random_state = 7;
+    for (fill = 0; fill < 8 && failed == NULL; fill++) {
+        // Random pixels, then runs of one shade like real backgrounds
+        for (int y = 0; y < SCR_HEIGHT; y++) {
+            for (int x = 0; x < SCR_WIDTH; x++)
+                gb_frame_buffer[y][x] = fill % 2 ? (x / (1 + fill) + y) & 3 : check_random() & 3;
+        }
+        for (int p = 0; p < (int)sizeof(palettes) && failed == NULL; p++) {
+            uint8_t bgp = palettes[p];
+            observe_gray(bgp, out);
+            for (int i = 0; i < SCR_WIDTH * SCR_HEIGHT; i++)
+                expected[i] = reference_gray(bgp, gb_frame_buffer[i / SCR_WIDTH][i % SCR_WIDTH]);
+            if (memcmp(out, expected, SCR_WIDTH * SCR_HEIGHT) != 0)
+                failed = "observe_gray";
+
+            for (int c = 0; c < 4 && failed == NULL; c++) {
+                int x = crops[c][0], y = crops[c][1], width = crops[c][2], height = crops[c][3];
+                observe_crop(bgp, x, y, width, height, out);
+                for (int i = 0; i < width * height; i++)
+                    expected[i] = reference_gray(bgp, gb_frame_buffer[y + i / width][x + i % width]);
+                if (memcmp(out, expected, (size_t)width * height) != 0)
+                    failed = "observe_crop";
+            }
+
+            for (int factor = 2; factor <= 4 && failed == NULL; factor += 2) {
+                int width = SCR_WIDTH / factor, height = SCR_HEIGHT / factor, area = factor * factor;
+                observe_downsample(bgp, factor, out);
+                for (int i = 0; i < width * height; i++) {
+                    int sum = 0;
+                    for (int dy = 0; dy < factor; dy++) {
+                        for (int dx = 0; dx < factor; dx++)
+                            sum += reference_gray(bgp, gb_frame_buffer[i / width * factor + dy][i % width * factor + dx]);
+                    }
+                    expected[i] = (sum + area / 2) / area;
+                }
+                if (memcmp(out, expected, (size_t)width * height) != 0)
+                    failed = factor == 2 ? "observe_downsample 2" : "observe_downsample 4";
+            }
+        }
+    }
+
+    // Four frames of 5 bytes numbered by age, shifting drops frame 0
+    uint8_t stack[20];
+    for (int i = 0; i < 20; i++)
+        stack[i] = i / 5;
+    uint8_t *newest = observe_stack_shift(stack, 4, 5);
+    memset(newest, 4, 5);
+    for (int i = 0; i < 20 && failed == NULL; i++) {
+        if (stack[i] != i / 5 + 1)
+            failed = "observe_stack_shift";
+    }
+
+#ifdef OBSERVE_SSE2
+    const char *kernels = "SSE2";
+#else
+    const char *kernels = "scalar";
+#endif
+    if (failed)
+        printf("observe: %s kernels, %s differs from the reference (fill %d)\n", kernels, failed, fill - 1);
+    else
+        printf("observe: %s kernels match the reference for %d frames x %d palettes\n",
+            kernels, fill, (int)sizeof(palettes));
+    return failed == NULL;
+}
+
+struct check {
+    const char *name;
+    bool (*run)();
+};
+
+struct check checks[] = {
+    {"env", check_env},
+    {"snapshot", check_snapshot},
+    {"observe", check_observe},
+    {"movie", check_movie},
+    {"link", check_link},
+};
+
+int main(int argc, char *argv[]) {
+    int count = sizeof(checks) / sizeof(checks[0]);
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        bool known = false;
+        for (int c = 0; c < count; c++)
+            known |= strcmp(argv[i], checks[c].name) == 0;
+        if (!known) {
+            fprintf(stderr, "usage: gb-check [env] [snapshot] [observe] [movie] [link]...\n");
+            return 1;
+        }
+    }
+    for (int c = 0; c < count; c++) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++)
+            selected |= strcmp(argv[i], checks[c].name) == 0;
+        if (selected)
+            ok &= checks[c].run();
+    }
+    return ok ? 0 : 1;
+}
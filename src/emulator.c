@@ -0,0 +1,114 @@
+#include "emulator.h"
+
+const int gb_total_dots_per_frame = 70224;
+int gb_frame_dot_counter = 0;
+
+uint16_t gb_opcode = 0;
+uint16_t gb_last_opcode = 0;
+int gb_instruction_counter = 0;
+uint64_t gb_total_M_cycles = 0;
+
+static uint32_t sample_countdown = 1;
+static uint32_t sample_random = 0x9E3779B9;
+
+// Instructions until the next timed one, uniform in 1..2*SUBSYSTEM_SAMPLE_INTERVAL-1
+static uint32_t next_sample_gap() {
+    sample_random ^= sample_random << 13;
+    sample_random ^= sample_random >> 17;
+    sample_random ^= sample_random << 5;
+    return 1 + sample_random % (2 * SUBSYSTEM_SAMPLE_INTERVAL - 1);
+}
+
+// Body of gb_step_instruction and gb_step_instruction_timed. times is a constant
+// at both call sites, so the clock reads compile away in gb_step_instruction.
+static inline int execute_instruction(struct subsystem_times *times) {
+    uint16_t instruction_pc = gb_cpu.PC;
+
+    // Fetch opcode
+    gb_last_opcode = gb_opcode;
+    gb_opcode = gb_memory[gb_cpu.PC];
+    if (gb_opcode == 0xCB) {
+        gb_opcode = (gb_opcode << 8) | gb_memory[gb_cpu.PC+1];
+    }
+
+    if (gb_tracer_enabled)
+        gb_trace_instruction(gb_opcode, gb_total_M_cycles);
+    if (gb_trace_compare_enabled)
+        gb_compare_instruction(gb_opcode, gb_total_M_cycles);
+
+    bool timed = times && --sample_countdown == 0;
+    uint64_t start = 0, cpu_done = 0, interrupts_done = 0;
+    if (timed) {
+        sample_countdown = next_sample_gap();
+        start = gb_host_time_ns();
+    }
+
+    PROFILE_OPCODE_BEGIN();
+    int M_cycles = gb_cpu_execute(gb_opcode);
+    PROFILE_OPCODE_END(gb_opcode, M_cycles);
+    if (timed)
+        cpu_done = gb_host_time_ns();
+    M_cycles += gb_handle_interrupts();
+    if (timed)
+        interrupts_done = gb_host_time_ns();
+    if (gb_lcd_enable())
+        gb_ppu_execute(4*M_cycles);
+    if (timed) {
+        uint64_t ppu_done = gb_host_time_ns();
+        // An empty interval, it holds the clock read every other one includes
+        uint64_t overhead = gb_host_time_ns() - ppu_done;
+        // A sample the host preempted would swamp thousands of others
+        if (ppu_done + overhead - start < SUBSYSTEM_MAX_SAMPLE_NS) {
+            times->cpu_ns += (cpu_done - start) * SUBSYSTEM_SAMPLE_INTERVAL;
+            times->interrupts_ns += (interrupts_done - cpu_done) * SUBSYSTEM_SAMPLE_INTERVAL;
+            times->ppu_ns += (ppu_done - interrupts_done) * SUBSYSTEM_SAMPLE_INTERVAL;
+            times->overhead_ns += overhead * SUBSYSTEM_SAMPLE_INTERVAL;
+        }
+    }
+
+    gb_frame_dot_counter += 4*M_cycles;
+    gb_total_M_cycles += M_cycles;
+    if (gb_serial_transfer_active)
+        gb_serial_tick(M_cycles);
+    if (gb_link_endpoint)
+        gb_link_tick(M_cycles);
+
+    if (gb_guest_profiler_enabled)
+        gb_guest_profiler_tick(instruction_pc, M_cycles);
+
+    gb_instruction_counter += 1;
+    return M_cycles;
+}
+
+int gb_step_instruction() {
+    return execute_instruction(NULL);
+}
+
+int gb_step_instruction_timed(struct subsystem_times *times) {
+    return execute_instruction(times);
+}
+
+void gb_run_frame() {
+    while (gb_frame_dot_counter < gb_total_dots_per_frame) {
+        gb_step_instruction();
+    }
+    gb_frame_dot_counter = 0;
+}
+
+void gb_run_frame_timed(struct subsystem_times *times) {
+    while (gb_frame_dot_counter < gb_total_dots_per_frame) {
+        gb_step_instruction_timed(times);
+    }
+    gb_frame_dot_counter = 0;
+}
+
+static uint64_t without_overhead(uint64_t ns, uint64_t overhead) {
+    return ns > overhead ? ns - overhead : 0;
+}
+
+void gb_subtract_clock_overhead(struct subsystem_times *times) {
+    times->cpu_ns = without_overhead(times->cpu_ns, times->overhead_ns);
+    times->interrupts_ns = without_overhead(times->interrupts_ns, times->overhead_ns);
+    times->ppu_ns = without_overhead(times->ppu_ns, times->overhead_ns);
+    times->overhead_ns = 0;
+}
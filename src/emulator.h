@@ -0,0 +1,49 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include "cpu.h"
+#include "ppu.h"
+#include "interrupt.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "tracecompare.h"
+#include "hosttime.h"
+
+extern const int gb_total_dots_per_frame;
+extern int gb_frame_dot_counter;
+
+extern uint16_t gb_opcode;
+extern uint16_t gb_last_opcode;
+extern int gb_instruction_counter;
+extern uint64_t gb_total_M_cycles;
+
+// Fetches and executes one instruction, services interrupts and catches the
+// PPU up. Returns the M-cycles taken.
+int gb_step_instruction();
+
+#define SUBSYSTEM_SAMPLE_INTERVAL 32
+#define SUBSYSTEM_MAX_SAMPLE_NS 20000
+
+// Host nanoseconds spent in each part of gb_step_instruction, estimated from
+// one instruction in SUBSYSTEM_SAMPLE_INTERVAL on average. The gaps between
+// samples are random, a fixed stride would keep timing the same instruction
+// of a guest loop whose length divides it. Each of the three also holds
+// overhead_ns of clock reads, gb_subtract_clock_overhead removes it.
+struct subsystem_times {
+    uint64_t cpu_ns;
+    uint64_t interrupts_ns;
+    uint64_t ppu_ns;
+    uint64_t overhead_ns;
+};
+
+// gb_step_instruction with host clock reads between subsystems on sampled
+// instructions, for the benchmark and timeline
+int gb_step_instruction_timed(struct subsystem_times *times);
+
+void gb_run_frame();
+
+void gb_run_frame_timed(struct subsystem_times *times);
+
+void gb_subtract_clock_overhead(struct subsystem_times *times);
+
+#endif
\ No newline at end of file
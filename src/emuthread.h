@@ -0,0 +1,144 @@
+#ifndef EMUTHREAD_H
+#define EMUTHREAD_H
+
+#include <SDL3/SDL.h>
+#include <string.h>
+
+#include "ppu.h"
+#include "pacing.h"
+#include "fastforward.h"
+
+// Runs the emulator on its own thread so presenting and vsync on the main
+// thread can't hold it up. Finished frames are handed over through a triple
+// buffer and input comes in through a single producer, single consumer
+// queue, both lock-free.
+
+#define INPUT_QUEUE_SIZE 64 // Power of two
+#define INPUT_PRESSED 0x100
+#define TRIPLE_BUFFER_FRESH 4
+
+struct frame_slot {
+    uint8_t pixels[SCR_HEIGHT][SCR_WIDTH];
+    Uint64 emu_ns;
+    int frame;
+};
+
+// Emulates one frame, returns SDL_APP_CONTINUE to keep going
+typedef SDL_AppResult (*emulate_function)();
+
+// Triple buffer: the emulation thread owns back_slot, the main thread owns
+// front_slot, middle_slot is swapped between them together with a flag
+// telling whether it holds a frame the main thread hasn't taken yet
+struct frame_slot frame_slots[3];
+int back_slot = 0;
+int front_slot = 1;
+SDL_AtomicInt middle_slot = {2};
+
+Uint16 input_queue[INPUT_QUEUE_SIZE];
+SDL_AtomicInt input_head; // Written by the main thread
+SDL_AtomicInt input_tail; // Written by the emulation thread
+
+SDL_Thread *emu_thread = NULL;
+SDL_Semaphore *frame_ready = NULL;
+SDL_AtomicInt emu_thread_running;
+SDL_AtomicInt emu_thread_result;
+emulate_function emulate_frame_function = NULL;
+
+// Main thread. Drops the event if the queue is full.
+bool push_input(uint8_t button, bool pressed) {
+    int head = SDL_GetAtomicInt(&input_head);
+    if (head - SDL_GetAtomicInt(&input_tail) == INPUT_QUEUE_SIZE)
+        return false;
+    input_queue[head & (INPUT_QUEUE_SIZE - 1)] = button | (pressed ? INPUT_PRESSED : 0);
+    SDL_SetAtomicInt(&input_head, head + 1);
+    return true;
+}
+
+// Emulation thread
+bool pop_input(uint8_t *button, bool *pressed) {
+    int tail = SDL_GetAtomicInt(&input_tail);
+    if (tail == SDL_GetAtomicInt(&input_head))
+        return false;
+    Uint16 event = input_queue[tail & (INPUT_QUEUE_SIZE - 1)];
+    SDL_SetAtomicInt(&input_tail, tail + 1);
+    *button = event & 0xFF;
+    *pressed = event & INPUT_PRESSED;
+    return true;
+}
+
+// Emulation thread: copies the frame buffer into the back slot and swaps it
+// with the middle one
+void publish_frame(Uint64 emu_ns, int frame) {
+    struct frame_slot *slot = &frame_slots[back_slot];
+    memcpy(slot->pixels, gb_frame_buffer, sizeof(slot->pixels));
+    slot->emu_ns = emu_ns;
+    slot->frame = frame;
+    back_slot = SDL_SetAtomicInt(&middle_slot, back_slot | TRIPLE_BUFFER_FRESH) & 3;
+    SDL_SignalSemaphore(frame_ready);
+}
+
+// Main thread: returns the newest frame, or NULL if none arrived since the
+// last call
+struct frame_slot *take_frame() {
+    if (!(SDL_GetAtomicInt(&middle_slot) & TRIPLE_BUFFER_FRESH))
+        return NULL;
+    front_slot = SDL_SetAtomicInt(&middle_slot, front_slot) & 3;
+    return &frame_slots[front_slot];
+}
+
+// Main thread: waits up to timeout_ms for a new frame
+struct frame_slot *wait_frame(Sint32 timeout_ms) {
+    struct frame_slot *slot = take_frame();
+    while (slot == NULL && SDL_WaitSemaphoreTimeout(frame_ready, timeout_ms))
+        slot = take_frame();
+    return slot;
+}
+
+int emulation_thread(void *data) {
+    int frame = 0;
+    while (SDL_GetAtomicInt(&emu_thread_running)) {
+        bool fast = fast_forward_active();
+        fast_forward_begin_frame(fast);
+        Uint64 start = SDL_GetTicksNS();
+        SDL_AppResult result = emulate_frame_function();
+        Uint64 emu_ns = SDL_GetTicksNS() - start;
+        if (result != SDL_APP_CONTINUE) {
+            SDL_SetAtomicInt(&emu_thread_result, result);
+            SDL_SignalSemaphore(frame_ready);
+            break;
+        }
+        frame++;
+        if (!gb_ppu_skip_composition)
+            publish_frame(emu_ns, frame);
+        if (fast)
+            fast_forward_pace();
+        else
+            pace_frame();
+    }
+    return 0;
+}
+
+bool start_emulation_thread(emulate_function emulate) {
+    emulate_frame_function = emulate;
+    frame_ready = SDL_CreateSemaphore(0);
+    SDL_SetAtomicInt(&emu_thread_result, SDL_APP_CONTINUE);
+    SDL_SetAtomicInt(&emu_thread_running, 1);
+    emu_thread = SDL_CreateThread(emulation_thread, "emulation", NULL);
+    if (emu_thread == NULL) {
+        SDL_Log("Couldn't start emulation thread: %s", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+// Main thread: the emulator state can be used again once this returns
+void stop_emulation_thread() {
+    if (emu_thread == NULL)
+        return;
+    SDL_SetAtomicInt(&emu_thread_running, 0);
+    SDL_WaitThread(emu_thread, NULL);
+    emu_thread = NULL;
+    SDL_DestroySemaphore(frame_ready);
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef FASTFORWARD_H
+#define FASTFORWARD_H
+
+#include <SDL3/SDL.h>
+
+#include "ppu.h"
+#include "pacing.h"
+
+// Fast-forward while a key is held or after it's toggled on. Runs at
+// fast_forward_speed times real time, or as fast as possible when that's 0.
+// Only frames due for the display are composed by the PPU, and audio is
+// dropped instead of queued.
+
+#define FAST_FORWARD_HELD 1
+#define FAST_FORWARD_TOGGLED 2
+#define FAST_FORWARD_SHOWN_FPS 60
+
+SDL_AtomicInt fast_forward_state; // Set by the main thread
+double fast_forward_speed = 0;
+Uint64 next_shown_frame_ns = 0;
+Uint64 next_fast_frame_ns = 0;
+
+void set_fast_forward(int flag, bool on) {
+    int state, new_state;
+    do {
+        state = SDL_GetAtomicInt(&fast_forward_state);
+        new_state = on ? state | flag : state & ~flag;
+    } while (!SDL_CompareAndSwapAtomicInt(&fast_forward_state, state, new_state));
+}
+
+void toggle_fast_forward() {
+    int state;
+    do {
+        state = SDL_GetAtomicInt(&fast_forward_state);
+    } while (!SDL_CompareAndSwapAtomicInt(&fast_forward_state, state, state ^ FAST_FORWARD_TOGGLED));
+}
+
+bool fast_forward_active() {
+    return SDL_GetAtomicInt(&fast_forward_state) != 0;
+}
+
+// Called before each emulated frame, decides whether the PPU composes it
+void fast_forward_begin_frame(bool fast) {
+    Uint64 now = SDL_GetTicksNS();
+    if (!fast || now >= next_shown_frame_ns) {
+        gb_ppu_skip_composition = false;
+        next_shown_frame_ns = now + 1000000000 / FAST_FORWARD_SHOWN_FPS;
+    }
+    else
+        gb_ppu_skip_composition = true;
+}
+
+// Called after each emulated frame instead of pace_frame while fast-forwarding
+void fast_forward_pace() {
+    Uint64 now = SDL_GetTicksNS();
+    if (fast_forward_speed <= 0) {
+        next_fast_frame_ns = now;
+        return;
+    }
+
+    Uint64 frame_ns = (Uint64)(1e9 / GB_FRAME_RATE / fast_forward_speed);
+    next_fast_frame_ns += frame_ns;
+    if (next_fast_frame_ns > now)
+        SDL_DelayNS(next_fast_frame_ns - now);
+    else if (now - next_fast_frame_ns > 4 * frame_ns)
+        next_fast_frame_ns = now;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "movie.h"
+#include "state.h"
+
+// Fork server: boots a ROM, runs it to a warm state once, then answers
+// rollout requests over a Unix socket. Every connection gets its own
+// process, and every request on it is run by a fork of that process, so
+// each rollout starts from the warm state through the kernel's
+// copy-on-write pages instead of reloading and replaying.
+//
+// A request is a struct fork_request followed by frame_count joypad bytes
+// (BUTTON_* bits), one per frame. The answer is a struct fork_response
+// followed by ram_length bytes of memory from ram_address. Both use the
+// host's byte order.
+
+#define FORK_SERVER_MAGIC 0x53464247 // "GBFS"
+#define MAX_ROLLOUT_FRAMES (1 << 24)
+
+struct fork_request {
+    uint32_t magic;
+    uint32_t frame_count;
+    uint16_t ram_address;
+    uint16_t ram_length; // 0 means none, capped at the end of memory
+};
+
+struct fork_response {
+    uint32_t status; // 0 ok, 1 bad request
+    uint32_t instructions;
+    uint64_t M_cycles;
+    uint64_t frame_hash;
+    uint32_t ram_length;
+    uint32_t reserved;
+};
+
+#ifdef _WIN32
+int main(int argc, char *argv[]) {
+    fprintf(stderr, "The fork server needs fork() and Unix sockets\n");
+    return 1;
+}
+#else
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+bool read_all(int fd, void *data, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+        ssize_t got = read(fd, (char *)data + received, size - received);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        received += got;
+    }
+    return true;
+}
+
+// Runs in the forked child: plays the inputs from the warm state and
+// answers. Never returns.
+void run_rollout(int client, struct fork_request *request, uint8_t *inputs) {
+    int start_instructions = gb_instruction_counter;
+    uint64_t start_cycles = gb_total_M_cycles;
+    for (uint32_t frame = 0; frame < request->frame_count; frame++) {
+        gb_set_joypad_buttons(inputs[frame]);
+        gb_run_frame();
+    }
+
+    struct fork_response response = {0};
+    response.instructions = gb_instruction_counter - start_instructions;
+    response.M_cycles = gb_total_M_cycles - start_cycles;
+    response.frame_hash = gb_xxh64(gb_frame_buffer, sizeof(gb_frame_buffer), 0);
+    response.ram_length = request->ram_length;
+    if (request->ram_address + response.ram_length > 0x10000)
+        response.ram_length = 0x10000 - request->ram_address;
+    gb_write_all(client, &response, sizeof(response));
+    gb_write_all(client, &gb_memory[request->ram_address], response.ram_length);
+    _exit(0);
+}
+
+// Answers requests on one connection in order until the client hangs up
+void serve_connection(int client) {
+    struct fork_request request;
+    uint8_t *inputs = NULL;
+    while (read_all(client, &request, sizeof(request))) {
+        if (request.magic != FORK_SERVER_MAGIC || request.frame_count > MAX_ROLLOUT_FRAMES) {
+            struct fork_response response = {1};
+            gb_write_all(client, &response, sizeof(response));
+            break;
+        }
+        inputs = realloc(inputs, request.frame_count + 1);
+        if (!read_all(client, inputs, request.frame_count))
+            break;
+
+        pid_t pid = fork();
+        if (pid == 0)
+            run_rollout(client, &request, inputs);
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        int status = 0;
+        pid_t waited;
+        while ((waited = waitpid(pid, &status, 0)) < 0 && errno == EINTR);
+        if (waited < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "Rollout process died\n");
+            break;
+        }
+    }
+    free(inputs);
+    close(client);
+    _exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    char *rom_path = NULL;
+    char *socket_path = NULL;
+    char *movie_path = NULL;
+    int warmup_frames = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i+1 < argc)
+            warmup_frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--play") == 0 && i+1 < argc)
+            movie_path = argv[++i];
+        else if (rom_path == NULL)
+            rom_path = argv[i];
+        else
+            socket_path = argv[i];
+    }
+    if (rom_path == NULL || socket_path == NULL) {
+        fprintf(stderr, "usage: forkserver rom.gb socket [--frames N] [--play movie.gbm]\n");
+        return 1;
+    }
+
+    if (!gb_init_memory(rom_path))
+        return 1;
+    gb_init_cpu_registers();
+    if (movie_path) {
+        if (!movie_start_playback(movie_path))
+            return 1;
+        while (!movie_finished()) {
+            movie_frame_input();
+            gb_run_frame();
+        }
+        movie_stop();
+    }
+    for (int frame = 0; frame < warmup_frames; frame++)
+        gb_run_frame();
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long\n");
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+    // Only replaces a socket left by an earlier server, never another file
+    struct stat existing;
+    if (lstat(socket_path, &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            fprintf(stderr, "%s exists and is not a socket\n", socket_path);
+            return 1;
+        }
+        unlink(socket_path);
+    }
+    if (server < 0 || bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server, 64) != 0) {
+        perror(socket_path);
+        return 1;
+    }
+    signal(SIGCHLD, SIG_IGN); // Connection processes are never waited for
+    signal(SIGPIPE, SIG_IGN);
+    printf("Serving %s on %s\n", rom_path, socket_path);
+    fflush(stdout);
+
+    while (true) {
+        int client = accept(server, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(server);
+            signal(SIGCHLD, SIG_DFL);
+            serve_connection(client);
+        }
+        close(client);
+    }
+}
+#endif
@@ -0,0 +1,132 @@
+#define GBCORE_BUILD
+#include "gbcore.h"
+#include "state.h"
+
+#define GBCORE_STATE_MAGIC 0x53434247 // "GBCS"
+
+struct gbcore {
+    struct gb_state state; // Only up to date while another instance is resident
+    uint64_t rom_hash;
+    uint16_t opcode;
+    uint16_t last_opcode;
+    int instruction_counter;
+    uint64_t total_M_cycles;
+};
+
+// What gbcore_save_state writes, the ROM hash keeps states of other games out.
+// The caller's buffer needn't be aligned, so it's only accessed through memcpy.
+struct gbcore_saved_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint64_t rom_hash;
+};
+
+#define GBCORE_SAVED_STATE_SIZE (sizeof(struct gbcore_saved_header) + sizeof(struct gb_state))
+
+static struct gbcore *resident_core = NULL;
+
+// Puts core in the emulator, saving the instance that was there
+static void switch_to_core(struct gbcore *core) {
+    if (resident_core == core)
+        return;
+    if (resident_core) {
+        struct gbcore *previous = resident_core;
+        gb_save_state(&previous->state);
+        previous->rom_hash = gb_rom_hash;
+        previous->opcode = gb_opcode;
+        previous->last_opcode = gb_last_opcode;
+        previous->instruction_counter = gb_instruction_counter;
+        previous->total_M_cycles = gb_total_M_cycles;
+    }
+    gb_load_state(&core->state);
+    gb_rom_hash = core->rom_hash;
+    gb_opcode = core->opcode;
+    gb_last_opcode = core->last_opcode;
+    gb_instruction_counter = core->instruction_counter;
+    gb_total_M_cycles = core->total_M_cycles;
+    resident_core = core;
+}
+
+int gbcore_version(void) {
+    return GBCORE_VERSION;
+}
+
+struct gbcore *gbcore_create(void) {
+    // All zero is the power-off state gb_reset_emulator loads
+    return calloc(1, sizeof(struct gbcore));
+}
+
+void gbcore_destroy(struct gbcore *core) {
+    if (resident_core == core)
+        resident_core = NULL;
+    free(core);
+}
+
+bool gbcore_load_rom(struct gbcore *core, const uint8_t *rom, size_t size) {
+    if (size < 0x150 || size > 0x800000)
+        return false;
+    switch_to_core(core);
+    gb_reset_emulator();
+    gb_init_memory_from_buffer(rom, (int)size);
+    gb_init_cpu_registers();
+    return true;
+}
+
+uint64_t gbcore_run_cycles(struct gbcore *core, uint64_t M_cycles) {
+    switch_to_core(core);
+    uint64_t start = gb_total_M_cycles;
+    while (gb_total_M_cycles - start < M_cycles) {
+        gb_step_instruction();
+        if (gb_frame_dot_counter >= gb_total_dots_per_frame)
+            gb_frame_dot_counter -= gb_total_dots_per_frame;
+    }
+    return gb_total_M_cycles - start;
+}
+
+void gbcore_run_frame(struct gbcore *core) {
+    switch_to_core(core);
+    gb_run_frame();
+}
+
+const uint8_t *gbcore_framebuffer(struct gbcore *core) {
+    if (resident_core == core)
+        return &gb_frame_buffer[0][0];
+    return &core->state.frame_buffer[0][0];
+}
+
+void gbcore_set_buttons(struct gbcore *core, uint8_t buttons) {
+    switch_to_core(core);
+    gb_set_joypad_buttons(buttons);
+}
+
+size_t gbcore_state_size(void) {
+    return GBCORE_SAVED_STATE_SIZE;
+}
+
+bool gbcore_save_state(struct gbcore *core, void *buffer, size_t size) {
+    if (size < GBCORE_SAVED_STATE_SIZE)
+        return false;
+    switch_to_core(core);
+    struct gbcore_saved_header header = {GBCORE_STATE_MAGIC, GBCORE_VERSION, GBCORE_SAVED_STATE_SIZE, gb_rom_hash};
+    memcpy(buffer, &header, sizeof(header));
+    // A resident instance's state field is unused, so it holds the aligned copy
+    gb_save_state(&core->state);
+    memcpy((uint8_t *)buffer + sizeof(header), &core->state, sizeof(struct gb_state));
+    return true;
+}
+
+bool gbcore_load_state(struct gbcore *core, const void *buffer, size_t size) {
+    struct gbcore_saved_header header;
+    if (size < GBCORE_SAVED_STATE_SIZE)
+        return false;
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != GBCORE_STATE_MAGIC || header.version != GBCORE_VERSION || header.size != GBCORE_SAVED_STATE_SIZE)
+        return false;
+    switch_to_core(core);
+    if (header.rom_hash != gb_rom_hash)
+        return false;
+    memcpy(&core->state, (const uint8_t *)buffer + sizeof(header), sizeof(struct gb_state));
+    gb_load_state(&core->state);
+    return true;
+}
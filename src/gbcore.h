@@ -0,0 +1,90 @@
+#ifndef GBCORE_H
+#define GBCORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Stable C API of libgbcore, for hosts that embed the emulator without SDL.
+// This is the only header such a host needs. The core keeps its state in
+// globals, so each instance lives in a save state that is switched into the
+// emulator only when a call is for a different instance than the last one;
+// with a single instance nothing is ever copied. Calls must not overlap,
+// use one thread or a lock.
+
+#if defined(_WIN32) && defined(GBCORE_SHARED)
+#ifdef GBCORE_BUILD
+#define GBCORE_API __declspec(dllexport)
+#else
+#define GBCORE_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define GBCORE_API __attribute__((visibility("default")))
+#else
+#define GBCORE_API
+#endif
+
+#define GBCORE_VERSION 1
+
+#define GBCORE_SCREEN_WIDTH 160
+#define GBCORE_SCREEN_HEIGHT 144
+
+// Same bits as BUTTON_* in input.h, a set bit means the button is held
+#define GBCORE_BUTTON_RIGHT  0x01
+#define GBCORE_BUTTON_LEFT   0x02
+#define GBCORE_BUTTON_UP     0x04
+#define GBCORE_BUTTON_DOWN   0x08
+#define GBCORE_BUTTON_A      0x10
+#define GBCORE_BUTTON_B      0x20
+#define GBCORE_BUTTON_SELECT 0x40
+#define GBCORE_BUTTON_START  0x80
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gbcore;
+
+// GBCORE_VERSION of the library, to check against the header at runtime
+GBCORE_API int gbcore_version(void);
+
+// A powered-off instance, NULL if out of memory
+GBCORE_API struct gbcore *gbcore_create(void);
+
+GBCORE_API void gbcore_destroy(struct gbcore *core);
+
+// Copies the ROM out of rom, so the buffer can be freed afterwards, and
+// powers the instance on. Returns false for a buffer too small to hold a
+// cartridge header.
+GBCORE_API bool gbcore_load_rom(struct gbcore *core, const uint8_t *rom, size_t size);
+
+// Runs whole instructions until at least M_cycles have passed and returns
+// how many did
+GBCORE_API uint64_t gbcore_run_cycles(struct gbcore *core, uint64_t M_cycles);
+
+// Runs to the end of the current frame
+GBCORE_API void gbcore_run_frame(struct gbcore *core);
+
+// GBCORE_SCREEN_HEIGHT rows of GBCORE_SCREEN_WIDTH color indices 0-3. Valid
+// until the next call for any instance.
+GBCORE_API const uint8_t *gbcore_framebuffer(struct gbcore *core);
+
+// GBCORE_BUTTON_* bits held from now on
+GBCORE_API void gbcore_set_buttons(struct gbcore *core, uint8_t buttons);
+
+GBCORE_API size_t gbcore_state_size(void);
+
+// Writes gbcore_state_size() bytes to buffer. Returns false if size is
+// smaller.
+GBCORE_API bool gbcore_save_state(struct gbcore *core, void *buffer, size_t size);
+
+// Restores a state saved from an instance running the same ROM with the
+// same library version. Returns false and leaves the instance alone if
+// it's from anything else.
+GBCORE_API bool gbcore_load_state(struct gbcore *core, const void *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,427 @@
+#ifndef GBENV_H
+#define GBENV_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "state.h"
+#include "workers.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Batch of emulator instances running one ROM, for reinforcement learning.
+// The core lives in globals, so instances are kept as save states and
+// switched in only when the next one to run isn't the one already loaded.
+// With several workers each forked process owns a contiguous slice of the
+// instances, and actions, observations and rewards are passed through
+// shared memory. Without workers the instances run in the calling process
+// and overwrite its emulator state.
+
+#define GB_ENV_MAX_REWARDS 16
+
+enum gb_env_command {
+    GB_ENV_STEP = 1,
+    GB_ENV_RESET,
+    GB_ENV_QUIT
+};
+
+// Reward read from memory after every step, scaled. Delta rewards pay the
+// change since the previous step, for scores and counters.
+struct gb_env_reward {
+    uint16_t address;
+    uint8_t bytes; // 1 or 2, little endian
+    bool delta;
+    float scale;
+};
+
+// Instances owned by one process
+struct gb_env_slice {
+    int first;
+    int last;
+    int current; // Instance loaded in the globals, -1 if none
+    struct gb_state *states;
+    uint16_t *reward_values; // Last value of every reward for every instance
+};
+
+struct gb_env {
+    int count;
+    int frame_skip;
+    int downsample;
+    int observation_width;
+    int observation_height;
+    int observation_size;
+    struct gb_state *initial_state;
+    struct gb_env_reward rewards[GB_ENV_MAX_REWARDS];
+    int reward_count;
+
+    // Shared with the workers
+    void *shared;
+    size_t shared_size;
+    uint8_t *actions;
+    uint8_t *resets;
+    float *step_rewards;
+    uint8_t *observations;
+
+    int workers;
+    bool started;
+    struct gb_env_slice local;
+#ifndef _WIN32
+    pid_t *pids;
+    int *command_pipes;
+    int *done_pipes;
+#endif
+};
+
+// Bytes of one instance's observation: the frame buffer's 2-bit color
+// indices, keeping one pixel out of every downsample x downsample block
+int gb_env_observation_size(struct gb_env *env) {
+    return env->observation_size;
+}
+
+// Observations of all instances, back to back. Passing this buffer to
+// gb_env_step saves copying the observations out of shared memory.
+uint8_t *gb_env_observations(struct gb_env *env) {
+    return env->observations;
+}
+
+void *allocate_shared(size_t size) {
+#ifdef _WIN32
+    return calloc(1, size);
+#else
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+#endif
+}
+
+void free_shared(void *memory, size_t size) {
+#ifdef _WIN32
+    free(memory);
+#else
+    munmap(memory, size);
+#endif
+}
+
+// Loads the ROM and snapshots the power-on state that instances start from
+// and reset to. workers is the number of processes to fork, 0 or 1 runs
+// everything in the calling process.
+struct gb_env *gb_env_create(char *rom_path, int count, int frame_skip, int downsample, int workers) {
+    if (count < 1 || frame_skip < 1 || (downsample != 1 && downsample != 2 && downsample != 4)) {
+        fprintf(stderr, "Invalid environment parameters\n");
+        return NULL;
+    }
+    struct gb_env *env = calloc(1, sizeof(struct gb_env));
+    env->count = count;
+    env->frame_skip = frame_skip;
+    env->downsample = downsample;
+    env->observation_width = SCR_WIDTH / downsample;
+    env->observation_height = SCR_HEIGHT / downsample;
+    env->observation_size = env->observation_width * env->observation_height;
+#ifdef _WIN32
+    env->workers = 1;
+#else
+    env->workers = workers < 1 ? 1 : workers > count ? count : workers;
+#endif
+
+    gb_reset_emulator();
+    if (!gb_init_memory(rom_path)) {
+        free(env);
+        return NULL;
+    }
+    gb_init_cpu_registers();
+    env->initial_state = malloc(sizeof(struct gb_state));
+    gb_save_state(env->initial_state);
+
+    env->shared_size = count * (2 + sizeof(float) + env->observation_size);
+    env->shared = allocate_shared(env->shared_size);
+    if (env->shared == NULL) {
+        fprintf(stderr, "Could not allocate shared memory for %d instances\n", count);
+        free(env->initial_state);
+        free(env);
+        return NULL;
+    }
+    env->step_rewards = (float *)env->shared;
+    env->actions = (uint8_t *)(env->step_rewards + count);
+    env->resets = env->actions + count;
+    env->observations = env->resets + count;
+    return env;
+}
+
+// Starts new instances from the given state instead of power-on, for
+// example after skipping a title screen. Call before the first step.
+void gb_env_set_initial_state(struct gb_env *env, const struct gb_state *state) {
+    *env->initial_state = *state;
+}
+
+bool gb_env_add_reward(struct gb_env *env, uint16_t address, int bytes, float scale, bool delta) {
+    if (env->started || env->reward_count == GB_ENV_MAX_REWARDS || (bytes != 1 && bytes != 2))
+        return false;
+    struct gb_env_reward *reward = &env->rewards[env->reward_count++];
+    reward->address = address;
+    reward->bytes = bytes;
+    reward->scale = scale;
+    reward->delta = delta;
+    return true;
+}
+
+uint16_t read_reward_value(struct gb_env_reward *reward, const uint8_t *memory) {
+    if (reward->bytes == 2)
+        return memory[reward->address] | (memory[(uint16_t)(reward->address + 1)] << 8);
+    return memory[reward->address];
+}
+
+void init_slice(struct gb_env *env, struct gb_env_slice *slice, int first, int last) {
+    slice->first = first;
+    slice->last = last;
+    slice->current = -1;
+    slice->states = malloc((last - first) * sizeof(struct gb_state));
+    slice->reward_values = calloc((last - first) * GB_ENV_MAX_REWARDS, sizeof(uint16_t));
+    for (int i = first; i < last; i++) {
+        slice->states[i - first] = *env->initial_state;
+        for (int r = 0; r < env->reward_count; r++)
+            slice->reward_values[(i - first) * GB_ENV_MAX_REWARDS + r] = read_reward_value(&env->rewards[r], env->initial_state->memory);
+    }
+}
+
+void free_slice(struct gb_env_slice *slice) {
+    free(slice->states);
+    free(slice->reward_values);
+}
+
+// Makes instance i the one in the globals
+void switch_instance(struct gb_env_slice *slice, int i) {
+    if (slice->current == i)
+        return;
+    if (slice->current >= 0)
+        gb_save_state(&slice->states[slice->current - slice->first]);
+    gb_load_state(&slice->states[i - slice->first]);
+    slice->current = i;
+}
+
+void write_observation(struct gb_env *env, int i) {
+    uint8_t *out = env->observations + (size_t)i * env->observation_size;
+    int step = env->downsample;
+    for (int y = 0; y < env->observation_height; y++) {
+        for (int x = 0; x < env->observation_width; x++)
+            *out++ = gb_frame_buffer[y * step][x * step];
+    }
+}
+
+void reset_instance(struct gb_env *env, struct gb_env_slice *slice, int i) {
+    if (slice->current == i)
+        gb_load_state(env->initial_state);
+    else
+        slice->states[i - slice->first] = *env->initial_state;
+    switch_instance(slice, i);
+
+    uint16_t *values = &slice->reward_values[(i - slice->first) * GB_ENV_MAX_REWARDS];
+    for (int r = 0; r < env->reward_count; r++)
+        values[r] = read_reward_value(&env->rewards[r], gb_memory);
+    env->step_rewards[i] = 0;
+    env->resets[i] = 0;
+    write_observation(env, i);
+}
+
+void step_instance(struct gb_env *env, struct gb_env_slice *slice, int i) {
+    switch_instance(slice, i);
+    gb_set_joypad_buttons(env->actions[i]);
+    for (int frame = 0; frame < env->frame_skip; frame++)
+        gb_run_frame();
+
+    float reward = 0;
+    uint16_t *values = &slice->reward_values[(i - slice->first) * GB_ENV_MAX_REWARDS];
+    for (int r = 0; r < env->reward_count; r++) {
+        uint16_t value = read_reward_value(&env->rewards[r], gb_memory);
+        reward += env->rewards[r].scale * (env->rewards[r].delta ? (float)value - values[r] : value);
+        values[r] = value;
+    }
+    env->step_rewards[i] = reward;
+    write_observation(env, i);
+}
+
+void run_slice(struct gb_env *env, struct gb_env_slice *slice, enum gb_env_command command) {
+    for (int i = slice->first; i < slice->last; i++) {
+        if (env->resets[i])
+            reset_instance(env, slice, i);
+        else if (command == GB_ENV_STEP)
+            step_instance(env, slice, i);
+    }
+}
+
+#ifndef _WIN32
+void env_worker(struct gb_env *env, int first, int last, int command_fd, int done_fd) {
+    struct gb_env_slice slice;
+    init_slice(env, &slice, first, last);
+    uint8_t command;
+    while (read(command_fd, &command, 1) == 1 && command != GB_ENV_QUIT) {
+        run_slice(env, &slice, command);
+        if (write(done_fd, &command, 1) != 1)
+            break;
+    }
+    _exit(0);
+}
+
+// Writes command to the first count workers. The pipe of a dead worker
+// raises SIGPIPE, which would kill the caller, so it's ignored for the
+// duration and the write fails instead.
+bool send_env_command(struct gb_env *env, int count, uint8_t command) {
+    struct sigaction ignore, previous;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPIPE, &ignore, &previous);
+    bool ok = true;
+    for (int w = 0; w < count; w++)
+        ok &= write(env->command_pipes[w], &command, 1) == 1;
+    sigaction(SIGPIPE, &previous, NULL);
+    return ok;
+}
+
+// Quits and reaps the first count workers and frees the worker arrays
+void stop_env_workers(struct gb_env *env, int count) {
+    send_env_command(env, count, GB_ENV_QUIT);
+    for (int w = 0; w < count; w++) {
+        close(env->command_pipes[w]);
+        close(env->done_pipes[w]);
+    }
+    for (int w = 0; w < count; w++)
+        while (waitpid(env->pids[w], NULL, 0) < 0 && errno == EINTR);
+    free(env->pids);
+    free(env->command_pipes);
+    free(env->done_pipes);
+    env->pids = NULL;
+    env->command_pipes = NULL;
+    env->done_pipes = NULL;
+}
+#endif
+
+// Forks the workers, or sets up the local slice without workers. If that
+// fails the workers already forked are stopped and the next call tries again.
+bool start_env(struct gb_env *env) {
+    if (env->workers == 1) {
+        init_slice(env, &env->local, 0, env->count);
+        env->started = true;
+        return true;
+    }
+#ifndef _WIN32
+    env->pids = calloc(env->workers, sizeof(pid_t));
+    env->command_pipes = calloc(env->workers, sizeof(int));
+    env->done_pipes = calloc(env->workers, sizeof(int));
+    fflush(stdout);
+    for (int w = 0; w < env->workers; w++) {
+        int command[2], done[2];
+        if (pipe(command) != 0) {
+            perror("pipe");
+            stop_env_workers(env, w);
+            return false;
+        }
+        if (pipe(done) != 0) {
+            perror("pipe");
+            close(command[0]);
+            close(command[1]);
+            stop_env_workers(env, w);
+            return false;
+        }
+        int first = (long)env->count * w / env->workers;
+        int last = (long)env->count * (w + 1) / env->workers;
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            close(command[0]);
+            close(command[1]);
+            close(done[0]);
+            close(done[1]);
+            stop_env_workers(env, w);
+            return false;
+        }
+        if (pid == 0) {
+            close(command[1]);
+            close(done[0]);
+            for (int other = 0; other < w; other++) {
+                close(env->command_pipes[other]);
+                close(env->done_pipes[other]);
+            }
+            env_worker(env, first, last, command[0], done[1]);
+        }
+        close(command[0]);
+        close(done[1]);
+        env->pids[w] = pid;
+        env->command_pipes[w] = command[1];
+        env->done_pipes[w] = done[0];
+    }
+    env->started = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Runs a command on every instance and waits until all are done. Returns
+// false if a worker died.
+bool run_env(struct gb_env *env, enum gb_env_command command) {
+    if (!env->started && !start_env(env))
+        return false;
+    if (env->workers == 1) {
+        run_slice(env, &env->local, command);
+        return true;
+    }
+#ifndef _WIN32
+    uint8_t byte;
+    bool ok = send_env_command(env, env->workers, command);
+    for (int w = 0; w < env->workers; w++)
+        ok &= read(env->done_pipes[w], &byte, 1) == 1;
+    return ok;
+#else
+    return false;
+#endif
+}
+
+// Applies one joypad action (BUTTON_* bits) per instance, runs frame_skip
+// frames on each and writes count observations and rewards. Instances
+// reset since the previous step start over instead and get a zero reward.
+bool gb_env_step(struct gb_env *env, const uint8_t *actions, uint8_t *observations, float *rewards) {
+    memcpy(env->actions, actions, env->count);
+    if (!run_env(env, GB_ENV_STEP))
+        return false;
+    if (observations && observations != env->observations)
+        memcpy(observations, env->observations, (size_t)env->count * env->observation_size);
+    if (rewards)
+        memcpy(rewards, env->step_rewards, env->count * sizeof(float));
+    return true;
+}
+
+// Puts instance i, or every instance if i is -1, back to the initial state
+// and writes its observation (all observations for -1)
+bool gb_env_reset(struct gb_env *env, int i, uint8_t *observation) {
+    if (i < 0)
+        memset(env->resets, 1, env->count);
+    else
+        env->resets[i] = 1;
+    if (!run_env(env, GB_ENV_RESET))
+        return false;
+    if (observation && i < 0)
+        memcpy(observation, env->observations, (size_t)env->count * env->observation_size);
+    else if (observation)
+        memcpy(observation, env->observations + (size_t)i * env->observation_size, env->observation_size);
+    return true;
+}
+
+void gb_env_destroy(struct gb_env *env) {
+    if (env->started && env->workers == 1)
+        free_slice(&env->local);
+#ifndef _WIN32
+    if (env->started && env->workers > 1)
+        stop_env_workers(env, env->workers);
+#endif
+    free_shared(env->shared, env->shared_size);
+    free(env->initial_state);
+    free(env);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "gbmemory.h"
+
+uint8_t gb_memory[0x10000];
+uint64_t gb_rom_hash = 0;
+
+void gb_init_memory_from_buffer(const uint8_t *rom, int rom_length){
+    // The hash identifies the whole cartridge, only bank 0 and 1 are mapped
+    gb_rom_hash = gb_xxh64(rom, rom_length, 0);
+    memcpy(gb_memory, rom, rom_length < 0x8000 ? rom_length : 0x8000);
+
+    if (gb_memory[0x147] == 0x01) {
+        
+    }
+
+    gb_memory[P1] = 0xCF;
+    gb_memory[SB] = 0x00;
+    gb_memory[SC] = 0x7E;
+    gb_memory[DIV] = 0xAB;
+    gb_memory[TIMA] = 0x00;
+    gb_memory[TMA] = 0x00;
+    gb_memory[TAC] = 0xF8;
+    gb_memory[IF] = 0xCF;
+    gb_memory[NR10] = 0x80;
+    gb_memory[NR11] = 0xBF;
+    gb_memory[NR12] = 0xF3;
+    gb_memory[NR13] = 0xFF;
+    gb_memory[NR14] = 0xBF;
+    gb_memory[NR21] = 0x3F;
+    gb_memory[NR22] = 0x00;
+    gb_memory[NR23] = 0XFF;
+    gb_memory[NR24] = 0xBF;
+    gb_memory[NR30] = 0x7F;
+    gb_memory[NR31] = 0xFF;
+    gb_memory[NR32] = 0x9F;
+    gb_memory[NR33] = 0xFF;
+    gb_memory[NR34] = 0xBF;
+    gb_memory[NR41] = 0xFF;
+    gb_memory[NR42] = 0x00;
+    gb_memory[NR43] = 0x00;
+    gb_memory[NR44] = 0xBF;
+    gb_memory[NR50] = 0x77;
+    gb_memory[NR51] = 0xF3;
+    gb_memory[NR52] = 0xF1;
+    gb_memory[LCDC] = 0x11;
+    gb_memory[STAT] = 0x82;
+    gb_memory[SCY] = 0x00;
+    gb_memory[SCX] = 0x00;
+    gb_memory[LY] = 0x91;
+    gb_memory[LYC] = 0x00;
+    gb_memory[DMA] = 0xFF;
+    gb_memory[BGP] = 0xFC;
+    gb_memory[WY] = 0x00;
+    gb_memory[WX] = 0x00;
+
+    uint8_t sprite[16] = {0x3C, 0x7E, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x5E, 0x7E, 0x0A, 0x7C, 0x56, 0x38, 0x7C};
+    for (int i = 0; i < 16; i++) {
+        gb_memory[0x8000+i] = sprite[i];
+    }
+    gb_memory[0xFE00] = 16;
+    gb_memory[0xFE01] = 8;
+    gb_memory[0xFE02] = 0;
+    gb_memory[0xFE03] = 0;
+}
+
+bool gb_init_memory(char* rom_path){
+    FILE *rom_file = fopen(rom_path, "rb");
+    if (rom_file == NULL) {
+        printf("Could not open file!\n");
+        return false;
+    }
+    fseek(rom_file, 0, SEEK_END);
+    int rom_length = ftell(rom_file);
+    fseek(rom_file, 0, SEEK_SET);
+    uint8_t *rom = malloc(rom_length);
+    rom_length = fread(rom, 1, rom_length, rom_file);
+    fclose(rom_file);
+
+    gb_init_memory_from_buffer(rom, rom_length);
+    free(rom);
+    return true;
+}
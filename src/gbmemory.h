@@ -2,6 +2,10 @@
 #define MEMORY_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "hash.h"
 
 #define P1 0xFF00
 #define SB 0xFF01
@@ -47,72 +51,11 @@
 
 #define IE 0xFFFF
 
-uint8_t memory[0x10000];
+extern uint8_t gb_memory[0x10000];
+extern uint64_t gb_rom_hash;
 
-void init_memory(char* rom_path){
-    FILE *rom_file = fopen(rom_path, "rb");
-    if (rom_file == NULL) {
-        printf("Could not open file!\n");
-    }
-    fseek(rom_file, 0, SEEK_END);
-    int rom_length = ftell(rom_file);
-    fseek(rom_file, 0, SEEK_SET);
-    fread(memory, 1, rom_length, rom_file);
-    fclose(rom_file);
+void gb_init_memory_from_buffer(const uint8_t *rom, int rom_length);
 
-    if (memory[0x147] == 0x01) {
-        
-    }
-
-    memory[P1] = 0xCF;
-    memory[SB] = 0x00;
-    memory[SC] = 0x7E;
-    memory[DIV] = 0xAB;
-    memory[TIMA] = 0x00;
-    memory[TMA] = 0x00;
-    memory[TAC] = 0xF8;
-    memory[IF] = 0xCF;
-    memory[NR10] = 0x80;
-    memory[NR11] = 0xBF;
-    memory[NR12] = 0xF3;
-    memory[NR13] = 0xFF;
-    memory[NR14] = 0xBF;
-    memory[NR21] = 0x3F;
-    memory[NR22] = 0x00;
-    memory[NR23] = 0XFF;
-    memory[NR24] = 0xBF;
-    memory[NR30] = 0x7F;
-    memory[NR31] = 0xFF;
-    memory[NR32] = 0x9F;
-    memory[NR33] = 0xFF;
-    memory[NR34] = 0xBF;
-    memory[NR41] = 0xFF;
-    memory[NR42] = 0x00;
-    memory[NR43] = 0x00;
-    memory[NR44] = 0xBF;
-    memory[NR50] = 0x77;
-    memory[NR51] = 0xF3;
-    memory[NR52] = 0xF1;
-    memory[LCDC] = 0x11;
-    memory[STAT] = 0x82;
-    memory[SCY] = 0x00;
-    memory[SCX] = 0x00;
-    memory[LY] = 0x91;
-    memory[LYC] = 0x00;
-    memory[DMA] = 0xFF;
-    memory[BGP] = 0xFC;
-    memory[WY] = 0x00;
-    memory[WX] = 0x00;
-
-    uint8_t sprite[16] = {0x3C, 0x7E, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x5E, 0x7E, 0x0A, 0x7C, 0x56, 0x38, 0x7C};
-    for (int i = 0; i < 16; i++) {
-        memory[0x8000+i] = sprite[i];
-    }
-    memory[0xFE00] = 16;
-    memory[0xFE01] = 8;
-    memory[0xFE02] = 0;
-    memory[0xFE03] = 0;
-    
-}
+bool gb_init_memory(char* rom_path);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "guestprofiler.h"
+
+bool gb_guest_profiler_enabled = false;
+static int sample_interval = 4096;
+static int sample_countdown = 4096;
+
+static uint32_t pc_histogram[GUEST_PROFILER_BANKS][0x10000];
+static uint64_t total_samples = 0;
+
+static struct call_node *call_nodes = NULL;
+static uint32_t call_node_count = 0;
+static struct call_frame call_stack[GUEST_PROFILER_MAX_DEPTH];
+static int call_depth = 0;
+
+static struct guest_symbol *guest_symbols = NULL;
+static int guest_symbol_count = 0;
+
+// There's no MBC yet, so bank 1 is always the one mapped at 0x4000-0x7FFF
+static uint8_t bank_for_address(uint16_t addr) {
+    return (addr >= 0x4000 && addr < 0x8000) ? 1 : 0;
+}
+
+void gb_guest_profiler_init(int interval) {
+    call_nodes = calloc(GUEST_PROFILER_MAX_NODES, sizeof(struct call_node));
+    call_node_count = 1; // Node 0 is the root, code running outside any call
+    call_depth = 0;
+    sample_interval = interval > 0 ? interval : 4096;
+    sample_countdown = sample_interval;
+    gb_guest_profiler_enabled = true;
+}
+
+static uint32_t current_call_node() {
+    return call_depth > 0 ? call_stack[call_depth-1].node : 0;
+}
+
+static uint32_t find_child_node(uint32_t parent, uint8_t bank, uint16_t addr) {
+    uint32_t child;
+    for (child = call_nodes[parent].first_child; child; child = call_nodes[child].next_sibling) {
+        if (call_nodes[child].bank == bank && call_nodes[child].addr == addr)
+            return child;
+    }
+    if (call_node_count >= GUEST_PROFILER_MAX_NODES)
+        return parent; // Out of nodes, fold deeper calls into the caller
+
+    child = call_node_count++;
+    call_nodes[child].parent = parent;
+    call_nodes[child].bank = bank;
+    call_nodes[child].addr = addr;
+    call_nodes[child].next_sibling = call_nodes[parent].first_child;
+    call_nodes[parent].first_child = child;
+    return child;
+}
+
+// Frames whose return address lies at or below sp have been popped or
+// abandoned (stack reset, return address popped manually)
+static void drop_stale_frames(uint16_t sp) {
+    while (call_depth > 0 && call_stack[call_depth-1].sp <= sp)
+        call_depth--;
+}
+
+void gb_guest_profiler_call(uint16_t target, uint16_t sp) {
+    drop_stale_frames(sp);
+    if (call_depth >= GUEST_PROFILER_MAX_DEPTH)
+        return;
+    call_stack[call_depth].node = find_child_node(current_call_node(), bank_for_address(target), target);
+    call_stack[call_depth].sp = sp;
+    call_depth++;
+}
+
+void gb_guest_profiler_return(uint16_t sp) {
+    drop_stale_frames(sp);
+}
+
+void gb_guest_profiler_tick(uint16_t pc, int M_cycles) {
+    sample_countdown -= M_cycles;
+    if (sample_countdown > 0)
+        return;
+    sample_countdown += sample_interval;
+
+    pc_histogram[bank_for_address(pc)][pc]++;
+    call_nodes[current_call_node()].samples++;
+    total_samples++;
+}
+
+static int compare_symbols(const void *a, const void *b) {
+    const struct guest_symbol *sym_a = a;
+    const struct guest_symbol *sym_b = b;
+    if (sym_a->bank != sym_b->bank)
+        return sym_a->bank - sym_b->bank;
+    return sym_a->addr - sym_b->addr;
+}
+
+bool gb_guest_profiler_load_symbols(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Could not open symbol file %s!\n", path);
+        return false;
+    }
+
+    guest_symbols = malloc(GUEST_PROFILER_MAX_SYMBOLS * sizeof(struct guest_symbol));
+    char line[256];
+    unsigned int bank, addr;
+    char name[64];
+    while (fgets(line, sizeof(line), file) && guest_symbol_count < GUEST_PROFILER_MAX_SYMBOLS) {
+        if (line[0] == ';')
+            continue;
+        if (sscanf(line, "%x:%x %63s", &bank, &addr, name) != 3)
+            continue;
+        // Only the ROM banks that can be mapped are useful, WRAM/HRAM symbols use bank 0
+        if (bank >= GUEST_PROFILER_BANKS)
+            continue;
+        guest_symbols[guest_symbol_count].bank = bank;
+        guest_symbols[guest_symbol_count].addr = addr;
+        strcpy(guest_symbols[guest_symbol_count].name, name);
+        guest_symbol_count++;
+    }
+    fclose(file);
+
+    qsort(guest_symbols, guest_symbol_count, sizeof(struct guest_symbol), compare_symbols);
+    return true;
+}
+
+// Formats an address as "Label+offset" using the closest preceding symbol
+// in the same bank, or "BB:AAAA" without one
+static void format_guest_address(char *out, size_t size, uint8_t bank, uint16_t addr) {
+    int low = 0, high = guest_symbol_count - 1, found = -1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        struct guest_symbol *sym = &guest_symbols[middle];
+        if (sym->bank < bank || (sym->bank == bank && sym->addr <= addr)) {
+            found = middle;
+            low = middle + 1;
+        }
+        else {
+            high = middle - 1;
+        }
+    }
+
+    if (found >= 0 && guest_symbols[found].bank == bank) {
+        uint16_t offset = addr - guest_symbols[found].addr;
+        if (offset == 0)
+            snprintf(out, size, "%s", guest_symbols[found].name);
+        else
+            snprintf(out, size, "%s+0x%X", guest_symbols[found].name, offset);
+    }
+    else {
+        snprintf(out, size, "%02X:%04X", bank, addr);
+    }
+}
+
+static void write_folded_stack(FILE *out, uint32_t node) {
+    if (node == 0) {
+        fprintf(out, "root");
+        return;
+    }
+    write_folded_stack(out, call_nodes[node].parent);
+    char name[96];
+    format_guest_address(name, sizeof(name), call_nodes[node].bank, call_nodes[node].addr);
+    fprintf(out, ";%s", name);
+}
+
+bool gb_guest_profiler_write_folded(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Could not open %s!\n", path);
+        return false;
+    }
+    for (uint32_t node = 0; node < call_node_count; node++) {
+        if (call_nodes[node].samples == 0)
+            continue;
+        write_folded_stack(out, node);
+        fprintf(out, " %llu\n", (unsigned long long)call_nodes[node].samples);
+    }
+    fclose(out);
+    return true;
+}
+
+static int compare_hot_spots(const void *a, const void *b) {
+    const struct hot_spot *spot_a = a;
+    const struct hot_spot *spot_b = b;
+    return (spot_a->samples < spot_b->samples) - (spot_a->samples > spot_b->samples);
+}
+
+void gb_guest_profiler_report(FILE *out, int count) {
+    fprintf(out, "Guest profile: %llu samples every %d M-cycles\n",
+        (unsigned long long)total_samples, sample_interval);
+
+    struct hot_spot *spots = malloc(GUEST_PROFILER_BANKS * 0x10000 * sizeof(struct hot_spot));
+    int spot_count = 0;
+    for (int bank = 0; bank < GUEST_PROFILER_BANKS; bank++) {
+        for (int pc = 0; pc < 0x10000; pc++) {
+            if (pc_histogram[bank][pc] == 0)
+                continue;
+            spots[spot_count].samples = pc_histogram[bank][pc];
+            spots[spot_count].bank = bank;
+            spots[spot_count].pc = pc;
+            spot_count++;
+        }
+    }
+    qsort(spots, spot_count, sizeof(struct hot_spot), compare_hot_spots);
+
+    for (int i = 0; i < spot_count && i < count; i++) {
+        char name[96];
+        format_guest_address(name, sizeof(name), spots[i].bank, spots[i].pc);
+        fprintf(out, "%6.2f%% %10u  %02X:%04X %s\n", 100.0 * spots[i].samples / total_samples,
+            spots[i].samples, spots[i].bank, spots[i].pc, name);
+    }
+    free(spots);
+}
@@ -0,0 +1,67 @@
+#ifndef GUESTPROFILER_H
+#define GUESTPROFILER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Sampling profiler for guest code. Every sample_interval M-cycles the
+// current (ROM bank, PC) is counted in a histogram and the current node of a
+// shadow call tree, built from CALL/RST/interrupts and RET/RETI, gets a hit.
+// The call tree is written as folded stacks ("a;b;c count") which flame
+// graph tools read directly.
+
+#define GUEST_PROFILER_BANKS 2
+#define GUEST_PROFILER_MAX_NODES 0x10000
+#define GUEST_PROFILER_MAX_DEPTH 256
+#define GUEST_PROFILER_MAX_SYMBOLS 0x10000
+
+struct call_node {
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint8_t bank;
+    uint16_t addr;
+    uint64_t samples;
+};
+
+struct call_frame {
+    uint32_t node;
+    uint16_t sp; // SP right after the return address was pushed
+};
+
+struct guest_symbol {
+    uint8_t bank;
+    uint16_t addr;
+    char name[64];
+};
+
+extern bool gb_guest_profiler_enabled;
+
+void gb_guest_profiler_init(int interval);
+
+// Called after a CALL, RST or interrupt has pushed the return address and jumped
+void gb_guest_profiler_call(uint16_t target, uint16_t sp);
+
+// Called before a RET or RETI pops the return address at sp
+void gb_guest_profiler_return(uint16_t sp);
+
+void gb_guest_profiler_tick(uint16_t pc, int M_cycles);
+
+// Reads an RGBDS .sym file, lines look like "01:4A3F Label"
+bool gb_guest_profiler_load_symbols(const char *path);
+
+bool gb_guest_profiler_write_folded(const char *path);
+
+struct hot_spot {
+    uint32_t samples;
+    uint8_t bank;
+    uint16_t pc;
+};
+
+// Prints the count most sampled (bank, PC) locations
+void gb_guest_profiler_report(FILE *out, int count);
+
+#endif
\ No newline at end of file
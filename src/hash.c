@@ -0,0 +1,81 @@
+#include "hash.h"
+
+static uint64_t xxh_rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t xxh_read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint32_t xxh_read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    acc = xxh_rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static uint64_t xxh64_merge_round(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t gb_xxh64(const void *data, size_t length, uint64_t seed) {
+    const uint8_t *p = data;
+    const uint8_t *end = p + length;
+    uint64_t h;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        do {
+            v1 = xxh64_round(v1, xxh_read64(p));
+            v2 = xxh64_round(v2, xxh_read64(p + 8));
+            v3 = xxh64_round(v3, xxh_read64(p + 16));
+            v4 = xxh64_round(v4, xxh_read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) + xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+        h = xxh64_merge_round(h, v1);
+        h = xxh64_merge_round(h, v2);
+        h = xxh64_merge_round(h, v3);
+        h = xxh64_merge_round(h, v4);
+    }
+    else {
+        h = seed + XXH_PRIME64_5;
+    }
+    h += length;
+
+    while (p + 8 <= end) {
+        h ^= xxh64_round(0, xxh_read64(p));
+        h = xxh_rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+        h = xxh_rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = xxh_rotl64(h, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
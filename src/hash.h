@@ -0,0 +1,19 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// XXH64, used for ROM identification and frame buffer hashes.
+// Produces the same values as the reference xxHash implementation.
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+uint64_t gb_xxh64(const void *data, size_t length, uint64_t seed);
+
+#endif
\ No newline at end of file
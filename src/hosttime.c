@@ -0,0 +1,22 @@
+#include "hosttime.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+uint64_t gb_host_time_ns() {
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / frequency.QuadPart);
+}
+#else
+#include <time.h>
+
+uint64_t gb_host_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
@@ -0,0 +1,10 @@
+#ifndef HOSTTIME_H
+#define HOSTTIME_H
+
+#include <stdint.h>
+
+// Monotonic host clock in nanoseconds, without going through SDL so the
+// core and headless tools can use it
+uint64_t gb_host_time_ns();
+
+#endif
\ No newline at end of file
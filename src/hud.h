@@ -0,0 +1,136 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "pacing.h"
+
+// Frame timing overlay and histogram. Each frame records the host time spent
+// emulating, rendering and presenting, and the time since the previous
+// frame started. The overlay shows the last HUD_HISTORY frames.
+
+#define HUD_HISTORY 120
+#define HUD_BIN_NS 250000 // 0.25 ms histogram bins
+#define HUD_BINS 400      // Up to 100 ms, longer frames go in the last bin
+#define HUD_GRAPH_HEIGHT 64
+#define HUD_GRAPH_MS_PER_PIXEL 0.5
+
+struct frame_timing {
+    Uint64 emu_ns;
+    Uint64 render_ns;
+    Uint64 present_ns;
+    Uint64 frame_ns;
+};
+
+bool hud_visible = false;
+struct frame_timing frame_history[HUD_HISTORY];
+int frame_history_next = 0;
+int frame_history_count = 0;
+Uint64 frame_histogram[HUD_BINS];
+Uint64 histogram_frames = 0;
+
+void hud_record_frame(struct frame_timing timing) {
+    frame_history[frame_history_next] = timing;
+    frame_history_next = (frame_history_next + 1) % HUD_HISTORY;
+    if (frame_history_count < HUD_HISTORY)
+        frame_history_count++;
+
+    Uint64 bin = timing.frame_ns / HUD_BIN_NS;
+    frame_histogram[bin < HUD_BINS ? bin : HUD_BINS - 1]++;
+    histogram_frames++;
+}
+
+int compare_ns(const void *a, const void *b) {
+    Uint64 x = *(const Uint64 *)a, y = *(const Uint64 *)b;
+    return (x > y) - (x < y);
+}
+
+// Frame time percentiles over the history window
+void history_percentiles(double *p50_ms, double *p99_ms) {
+    Uint64 sorted[HUD_HISTORY];
+    for (int i = 0; i < frame_history_count; i++)
+        sorted[i] = frame_history[i].frame_ns;
+    SDL_qsort(sorted, frame_history_count, sizeof(Uint64), compare_ns);
+    *p50_ms = sorted[frame_history_count / 2] / 1e6;
+    *p99_ms = sorted[frame_history_count * 99 / 100] / 1e6;
+}
+
+// Upper edge of the bin holding the given fraction of all frames
+double histogram_percentile(double fraction) {
+    Uint64 target = (Uint64)(histogram_frames * fraction);
+    Uint64 seen = 0;
+    for (int i = 0; i < HUD_BINS; i++) {
+        seen += frame_histogram[i];
+        if (seen > target)
+            return (i + 1) * HUD_BIN_NS / 1e6;
+    }
+    return HUD_BINS * HUD_BIN_NS / 1e6;
+}
+
+void hud_draw(SDL_Renderer *renderer) {
+    if (!hud_visible || frame_history_count == 0)
+        return;
+
+    struct frame_timing *last = &frame_history[(frame_history_next + HUD_HISTORY - 1) % HUD_HISTORY];
+    double p50, p99;
+    history_percentiles(&p50, &p99);
+
+    float x = 4, y = 4;
+    float width = HUD_HISTORY * 2 + 8;
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+    SDL_FRect background = {x, y, width, 5 * 10 + HUD_GRAPH_HEIGHT + 8};
+    SDL_RenderFillRect(renderer, &background);
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
+    SDL_RenderDebugTextFormat(renderer, x + 4, y + 4, "emu     %6.2f ms", last->emu_ns / 1e6);
+    SDL_RenderDebugTextFormat(renderer, x + 4, y + 14, "render  %6.2f ms", last->render_ns / 1e6);
+    SDL_RenderDebugTextFormat(renderer, x + 4, y + 24, "present %6.2f ms", last->present_ns / 1e6);
+    SDL_RenderDebugTextFormat(renderer, x + 4, y + 34, "frame   %6.2f ms", last->frame_ns / 1e6);
+    SDL_RenderDebugTextFormat(renderer, x + 4, y + 44, "p50 %.2f p99 %.2f", p50, p99);
+
+    // Frame time bars with the emulation share on top, oldest on the left
+    float base = y + 5 * 10 + HUD_GRAPH_HEIGHT + 4;
+    for (int i = 0; i < frame_history_count; i++) {
+        struct frame_timing *timing = &frame_history[(frame_history_next - frame_history_count + i + HUD_HISTORY) % HUD_HISTORY];
+        float frame_height = SDL_min(timing->frame_ns / 1e6 / HUD_GRAPH_MS_PER_PIXEL, HUD_GRAPH_HEIGHT);
+        float emu_height = SDL_min(timing->emu_ns / 1e6 / HUD_GRAPH_MS_PER_PIXEL, frame_height);
+        SDL_FRect bar = {x + 4 + i * 2, base - frame_height, 2, frame_height};
+        SDL_SetRenderDrawColor(renderer, 96, 160, 255, SDL_ALPHA_OPAQUE);
+        SDL_RenderFillRect(renderer, &bar);
+        bar.y = base - emu_height;
+        bar.h = emu_height;
+        SDL_SetRenderDrawColor(renderer, 255, 160, 64, SDL_ALPHA_OPAQUE);
+        SDL_RenderFillRect(renderer, &bar);
+    }
+
+    // Game Boy frame period
+    float target = base - (float)(1000.0 / GB_FRAME_RATE / HUD_GRAPH_MS_PER_PIXEL);
+    SDL_SetRenderDrawColor(renderer, 255, 64, 64, SDL_ALPHA_OPAQUE);
+    SDL_RenderLine(renderer, x + 4, target, x + width - 4, target);
+}
+
+// Writes the frame time histogram as "<bin start ms> <bin end ms> <frames>",
+// skipping empty bins
+bool hud_write_histogram(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        SDL_Log("Couldn't write frame histogram %s", path);
+        return false;
+    }
+    fprintf(out, "# %llu frames, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, p99.9 %.2f ms\n",
+        (unsigned long long)histogram_frames, histogram_percentile(0.5), histogram_percentile(0.9),
+        histogram_percentile(0.99), histogram_percentile(0.999));
+    for (int i = 0; i < HUD_BINS; i++) {
+        if (frame_histogram[i])
+            fprintf(out, "%.2f %.2f %llu\n", i * HUD_BIN_NS / 1e6,
+                i == HUD_BINS - 1 ? INFINITY : (i + 1) * HUD_BIN_NS / 1e6, (unsigned long long)frame_histogram[i]);
+    }
+    fclose(out);
+    return true;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#include "input.h"
+
+uint8_t gb_joypad_buttons = 0;
+
+// Buttons visible through the current P1 selection, as a 4-bit mask
+static uint8_t selected_buttons(uint8_t buttons) {
+    uint8_t pressed = 0;
+    if (!(gb_memory[P1] & SELECT_DPAD))
+        pressed |= buttons & 0xF;
+    if (!(gb_memory[P1] & SELECT_BUTTONS))
+        pressed |= buttons >> 4;
+    return pressed;
+}
+
+uint8_t gb_read_joypad() {
+    return 0xC0 | (gb_memory[P1] & 0x30) | (~selected_buttons(gb_joypad_buttons) & 0xF);
+}
+
+void gb_set_joypad_buttons(uint8_t buttons) {
+    uint8_t newly_pressed = selected_buttons(buttons & ~gb_joypad_buttons);
+    gb_joypad_buttons = buttons;
+    if (newly_pressed)
+        gb_memory[IF] |= 0x10;
+}
@@ -1,76 +1,31 @@
 #ifndef INPUT_H
 #define INPUT_H
 
-#include <SDL3/SDL.h>
-#include <SDL3/SDL_main.h>
-#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "gbmemory.h"
 
-void handle_input() {
-    const bool* key_state = SDL_GetKeyboardState(NULL);
+// Joypad bitmask, a set bit means the button is held.
+// Low nibble is the d-pad, high nibble the buttons, matching the P1 bit order.
+#define BUTTON_RIGHT  0x01
+#define BUTTON_LEFT   0x02
+#define BUTTON_UP     0x04
+#define BUTTON_DOWN   0x08
+#define BUTTON_A      0x10
+#define BUTTON_B      0x20
+#define BUTTON_SELECT 0x40
+#define BUTTON_START  0x80
 
-    if (!(memory[P1] & 0x10)) {
-        if (key_state[SDL_SCANCODE_S]) {
-            if (memory[P1] & 8) memory[IF] |= 0x10;
-            memory[P1] &= ~8;
-        }
-        else
-            memory[P1] |= 8;
+#define SELECT_DPAD    0x10
+#define SELECT_BUTTONS 0x20
 
-        if (key_state[SDL_SCANCODE_W]) {
-            if (memory[P1] & 4) memory[IF] |= 0x10;
-            memory[P1] &= ~4;
-        }
-        else
-            memory[P1] |= 4;
+extern uint8_t gb_joypad_buttons;
 
-        if (key_state[SDL_SCANCODE_A]) {
-            if (memory[P1] & 2) memory[IF] |= 0x10;
-            memory[P1] &= ~2;
-        }
-        else
-            memory[P1] |= 2;
+// P1 is computed when the CPU reads it instead of being rewritten every instruction
+uint8_t gb_read_joypad();
 
-        if (key_state[SDL_SCANCODE_D]) {
-            if (memory[P1] & 1) memory[IF] |= 0x10;
-            memory[P1] &= ~1;
-        }
-        else
-            memory[P1] |= 1;
-    }
-    if (!(memory[P1] & 0x20)) {
-        if (key_state[SDL_SCANCODE_X]) {
-            if (memory[P1] & 8) memory[IF] |= 0x10;
-            memory[P1] &= ~8;
-        }
-        else
-            memory[P1] |= 8;
-
-        if (key_state[SDL_SCANCODE_C]) {
-            if (memory[P1] & 4) memory[IF] |= 0x10;
-            memory[P1] &= ~4;
-        }
-        else
-            memory[P1] |= 4;
-
-        if (key_state[SDL_SCANCODE_J]) {
-            if (memory[P1] & 2) memory[IF] |= 0x10;
-            memory[P1] &= ~2;
-        }
-        else
-            memory[P1] |= 2;
-
-        if (key_state[SDL_SCANCODE_K]) {
-            if (memory[P1] & 1) memory[IF] |= 0x10;
-            memory[P1] &= ~1;
-        }
-        else
-            memory[P1] |= 1;
-    }
-
-    if (memory[P1] & 0x30) {
-        memory[P1] &= 0xF;
-    }
-}
+// Latches a new button state. The joypad interrupt fires on a high to low
+// transition of a selected P1 line, so only on newly pressed buttons.
+void gb_set_joypad_buttons(uint8_t buttons);
 
 #endif
\ No newline at end of file
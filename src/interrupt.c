@@ -0,0 +1,35 @@
+#include "interrupt.h"
+
+uint8_t gb_handle_interrupts() {
+    if (gb_IME_flag == 0)
+        return 0;
+    else if (gb_memory[IE] & gb_memory[IF] == 0)
+        return 0;
+
+    gb_memory[gb_cpu.SP-1] = gb_cpu.PC >> 8;
+    gb_memory[gb_cpu.SP-2] = gb_cpu.PC & 0xFF;
+    gb_cpu.SP -= 2;
+
+    if (gb_memory[IE] & 0x1 && gb_memory[IF] & 0x1) {
+        gb_cpu.PC = 0x40;
+        gb_memory[IF] &= ~0x1;
+    }
+    else if (gb_memory[IE] & 0x2 && gb_memory[IF] & 0x2) {
+        gb_cpu.PC = 0x48;
+        gb_memory[IF] &= ~0x2;
+    }
+    else if (gb_memory[IE] & 0x4 && gb_memory[IF] & 0x4) {
+        gb_cpu.PC = 0x50;
+        gb_memory[IF] &= ~0x4;
+    }
+    else if (gb_memory[IE] & 0x8 && gb_memory[IF] & 0x8) {
+        gb_cpu.PC = 0x58;
+        gb_memory[IF] &= ~0x8;
+    }
+    else if (gb_memory[IE] & 0x10 && gb_memory[IF] & 0x10) {
+        gb_cpu.PC = 0x58;
+        gb_memory[IF] &= ~0x10;
+    }
+    if (gb_guest_profiler_enabled) gb_guest_profiler_call(gb_cpu.PC, gb_cpu.SP);
+    return 5;
+}
@@ -0,0 +1,272 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "state.h"
+
+// Runs a link cable (serial.h) between two instances, either both in this
+// process as save states switched in whenever the running one has to wait
+// for the other, or one per process through a shared-memory channel.
+
+struct link_pair {
+    struct link_channel channel;
+    struct link_endpoint endpoints[2];
+    struct gb_state *states[2];
+    int current;            // Instance in the emulator, the other is in states
+    uint64_t target;        // M-cycles both have to reach
+    uint64_t switches;
+};
+
+void switch_link_instance(struct link_pair *pair) {
+    gb_save_state(pair->states[pair->current]);
+    pair->current = 1 - pair->current;
+    gb_load_state(pair->states[pair->current]);
+    gb_link_endpoint = &pair->endpoints[pair->current];
+    pair->switches++;
+}
+
+// Boots both ROMs, instance 0 is left in the emulator
+struct link_pair *link_pair_create(char *rom_paths[2], bool relaxed) {
+    struct link_pair *pair = calloc(1, sizeof(struct link_pair));
+    for (int i = 1; i >= 0; i--) {
+        pair->states[i] = malloc(sizeof(struct gb_state));
+        pair->endpoints[i] = (struct link_endpoint){&pair->channel, i, relaxed};
+        gb_reset_emulator();
+        if (!gb_init_memory(rom_paths[i])) {
+            free(pair->states[0]);
+            free(pair->states[1]);
+            free(pair);
+            return NULL;
+        }
+        gb_init_cpu_registers();
+        gb_save_state(pair->states[i]);
+    }
+    gb_link_endpoint = &pair->endpoints[0];
+    return pair;
+}
+
+void link_pair_destroy(struct link_pair *pair) {
+    gb_link_endpoint = NULL;
+    free(pair->states[0]);
+    free(pair->states[1]);
+    free(pair);
+}
+
+// A transfer past its time that relaxed mode holds until this side
+// requests one, the sender waits until it runs far enough to answer
+bool link_holding_transfer(struct link_endpoint *endpoint) {
+    return endpoint->transfer_pending && endpoint->pending_transfer.time <= endpoint->time;
+}
+
+// Runs both instances for M_cycles more. An instance that has to wait
+// hands over to the other, which runs at least up to where the first one
+// stopped so it can answer.
+void link_pair_run(struct link_pair *pair, uint64_t M_cycles) {
+    pair->target += M_cycles;
+    uint64_t needed = 0;
+    for (;;) {
+        struct link_endpoint *endpoint = gb_link_endpoint;
+        gb_link_receive(); // Answers a transfer due while this one was switched out
+        while ((endpoint->time < pair->target || endpoint->time < needed || link_holding_transfer(endpoint))
+            && gb_link_can_run()) {
+            gb_step_instruction();
+            if (gb_frame_dot_counter >= gb_total_dots_per_frame)
+                gb_frame_dot_counter -= gb_total_dots_per_frame;
+        }
+        bool blocked = endpoint->time < pair->target || endpoint->time < needed;
+        if (!blocked && pair->endpoints[1 - pair->current].time >= pair->target)
+            break;
+        needed = blocked ? endpoint->time : 0;
+        switch_link_instance(pair);
+    }
+}
+
+// Puts instance i in the emulator, to read its memory or frame buffer
+void link_pair_select(struct link_pair *pair, int i) {
+    if (pair->current != i)
+        switch_link_instance(pair);
+}
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LINK_ATTACH_TIMEOUT_MS 1000
+
+struct link_endpoint shared_link_endpoint;
+char shared_link_name[256];
+int shared_link_fd = -1; // Side 0 keeps the segment open to recognize it when closing
+
+// Sizes and maps a segment this process just created, as side 0
+struct link_channel *create_link_channel(int fd) {
+    if (ftruncate(fd, sizeof(struct link_channel)) != 0)
+        return NULL;
+    struct link_channel *channel = mmap(NULL, sizeof(struct link_channel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (channel == MAP_FAILED)
+        return NULL;
+    atomic_store(&channel->pids[0], getpid());
+    atomic_store(&channel->ready, LINK_CHANNEL_READY);
+    return channel;
+}
+
+// Maps an existing segment as side 1 once side 0 has sized and set it up,
+// mapping it earlier would fault past its end. Sets stale for a segment
+// whose creator crashed or left before anyone attached.
+struct link_channel *attach_link_channel(int fd, bool *stale) {
+    *stale = true;
+    struct stat status;
+    for (int waited = 0; fstat(fd, &status) == 0 && status.st_size < (off_t)sizeof(struct link_channel); waited++) {
+        if (waited == LINK_ATTACH_TIMEOUT_MS)
+            return NULL;
+        usleep(1000);
+    }
+    if (status.st_size < (off_t)sizeof(struct link_channel))
+        return NULL;
+    struct link_channel *channel = mmap(NULL, sizeof(struct link_channel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (channel == MAP_FAILED) {
+        *stale = false;
+        return NULL;
+    }
+    for (int waited = 0; atomic_load(&channel->ready) != LINK_CHANNEL_READY; waited++) {
+        if (waited == LINK_ATTACH_TIMEOUT_MS) {
+            munmap(channel, sizeof(struct link_channel));
+            return NULL;
+        }
+        usleep(1000);
+    }
+    pid_t creator = atomic_load(&channel->pids[0]);
+    int32_t unclaimed = 0;
+    if (atomic_load(&channel->closed[0]) || (kill(creator, 0) != 0 && errno == ESRCH)
+        || !atomic_compare_exchange_strong(&channel->pids[1], &unclaimed, getpid())) {
+        // A side 1 that is still running means the link is in use
+        if (unclaimed != 0 && !(kill(unclaimed, 0) != 0 && errno == ESRCH))
+            *stale = false;
+        munmap(channel, sizeof(struct link_channel));
+        return NULL;
+    }
+    return channel;
+}
+
+// Removes the name if it still is the segment open in fd. Another process
+// may have replaced a stale segment under the same name already.
+bool unlink_link_channel(int fd) {
+    struct stat own, current;
+    int current_fd = shm_open(shared_link_name, O_RDWR, 0600);
+    if (current_fd < 0)
+        return false;
+    bool same = fstat(fd, &own) == 0 && fstat(current_fd, &current) == 0
+        && own.st_dev == current.st_dev && own.st_ino == current.st_ino;
+    close(current_fd);
+    return same && shm_unlink(shared_link_name) == 0;
+}
+
+// Connects the emulator to the channel in shared memory name. The first
+// process creates it and becomes side 0, the second attaches as side 1. A
+// segment left behind by a crashed process is removed and created again.
+bool link_open_shared(const char *name, bool relaxed) {
+    snprintf(shared_link_name, sizeof(shared_link_name), "%s%s", name[0] == '/' ? "" : "/", name);
+    struct link_channel *channel = NULL;
+    int side = 0;
+    for (int attempt = 0; attempt < 3 && channel == NULL; attempt++) {
+        int fd = shm_open(shared_link_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd >= 0) {
+            side = 0;
+            channel = create_link_channel(fd);
+            if (channel == NULL) {
+                shm_unlink(shared_link_name);
+                close(fd);
+                break;
+            }
+            shared_link_fd = fd;
+            continue;
+        }
+        if (errno != EEXIST)
+            break;
+        fd = shm_open(shared_link_name, O_RDWR, 0600);
+        if (fd < 0)
+            continue; // Removed in between, create it
+        bool stale;
+        side = 1;
+        channel = attach_link_channel(fd, &stale);
+        if (channel == NULL && !stale) {
+            fprintf(stderr, "Link channel %s is already in use\n", shared_link_name);
+            close(fd);
+            return false;
+        }
+        if (channel == NULL && unlink_link_channel(fd))
+            fprintf(stderr, "Removed stale link channel %s\n", shared_link_name);
+        close(fd);
+    }
+    if (channel == NULL) {
+        fprintf(stderr, "Could not open link channel %s\n", shared_link_name);
+        return false;
+    }
+    shared_link_endpoint = (struct link_endpoint){channel, side, relaxed};
+    gb_link_endpoint = &shared_link_endpoint;
+    return true;
+}
+
+// Tells the other side to stop waiting for this one. Side 0 removes the
+// name unless a new channel replaced it, the other side keeps its mapping.
+void link_close_shared() {
+    if (gb_link_endpoint != &shared_link_endpoint)
+        return;
+    atomic_store(&shared_link_endpoint.channel->closed[shared_link_endpoint.side], 1);
+    if (shared_link_endpoint.side == 0) {
+        unlink_link_channel(shared_link_fd);
+        close(shared_link_fd);
+        shared_link_fd = -1;
+    }
+    munmap(shared_link_endpoint.channel, sizeof(struct link_channel));
+    gb_link_endpoint = NULL;
+}
+
+// Marks the other side closed if its process is gone without saying so,
+// after a crash or kill, so this side stops waiting for it
+void check_link_peer() {
+    struct link_channel *channel = shared_link_endpoint.channel;
+    int other = 1 - shared_link_endpoint.side;
+    pid_t peer = atomic_load(&channel->pids[other]);
+    if (peer != 0 && !atomic_load(&channel->closed[other]) && kill(peer, 0) != 0 && errno == ESRCH) {
+        fprintf(stderr, "Link peer %d exited without closing the channel\n", (int)peer);
+        atomic_store(&channel->closed[other], 1);
+    }
+}
+
+// gb_run_frame for a linked process, spinning while the other side catches up
+void link_run_frame() {
+    while (gb_frame_dot_counter < gb_total_dots_per_frame) {
+        for (int spins = 0; !gb_link_can_run(); spins++) {
+            if (spins > 1000)
+                sched_yield();
+            if (spins % 4096 == 4095)
+                check_link_peer();
+        }
+        gb_step_instruction();
+    }
+    gb_frame_dot_counter = 0;
+}
+#else
+bool link_open_shared(const char *name, bool relaxed) {
+    fprintf(stderr, "Linking processes isn't supported on this platform\n");
+    return false;
+}
+
+void link_close_shared() {
+}
+
+void link_run_frame() {
+    gb_run_frame();
+}
+#endif
+
+#endif
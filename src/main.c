@@ -10,6 +10,15 @@
 #include "ppu.h"
 #include "input.h"
 #include "interrupt.h"
+#include "emulator.h"
+#include "gbcore.h"
+#include "movie.h"
+#include "pacing.h"
+#include "hud.h"
+#include "timeline.h"
+#include "emuthread.h"
+#include "shmchannel.h"
+#include "link.h"
 
 #define PROGRAM "tetris.gb"
 
@@ -19,58 +28,196 @@ const struct color LIGHT_GREY = {0x8B, 0xAC, 0x0F};
 const struct color WHITE = {0x9B, 0xBC, 0x0F};
 
 struct color colors[4];
+Uint32 palette[4]; // colors as XRGB8888
 
 const double CPU_CLOCK_HZ = 4194304;
-double current_time;
-double last_time;
-double delta_time;
-double time_accumulator;
 
-const int total_dots_per_frame = 70224;
-int frame_dot_counter = 0;
-
-uint16_t opcode = 0;
-uint16_t last_opcode = 0;
-int instruction_counter = 0;
+char *rom_path = "ROMS/"PROGRAM;
+char *record_path = NULL;
+char *play_path = NULL;
+char *guest_profile_path = NULL;
+char *symbol_path = NULL;
+int guest_sample_interval = 0;
+char *trace_path = NULL;
+int trace_records = DEFAULT_TRACE_RECORDS;
+char *compare_path = NULL;
+char *histogram_path = NULL;
+char *timeline_output = NULL;
+int timeline_events_size = DEFAULT_TIMELINE_EVENTS;
+char *shm_channel_name = NULL;
+char *link_name = NULL;
+bool link_relaxed = false;
+bool headless = false;
+bool single_thread = false;
+bool vsync_enabled = false;
+SDL_AtomicInt trace_dump_requested;
+int frame_limit = 0;
+int frame_count = 0;
+Uint64 start_ticks = 0;
+struct gbcore *core = NULL;
 
 /* We will use this renderer to draw into this window every frame. */
 static SDL_Window *window = NULL;
 static SDL_Renderer *renderer = NULL;
+static SDL_Texture *screen_texture = NULL;
 static SDL_FPoint points[500];
 
+SDL_AppResult emulate_frame();
+
 
 
 /* This function runs once at startup. */
 SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[])
 {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i+1 < argc)
+            record_path = argv[++i];
+        else if (strcmp(argv[i], "--play") == 0 && i+1 < argc)
+            play_path = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i+1 < argc)
+            frame_limit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--guest-profile") == 0 && i+1 < argc)
+            guest_profile_path = argv[++i];
+        else if (strcmp(argv[i], "--sym") == 0 && i+1 < argc)
+            symbol_path = argv[++i];
+        else if (strcmp(argv[i], "--sample-interval") == 0 && i+1 < argc)
+            guest_sample_interval = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i+1 < argc)
+            trace_path = argv[++i];
+        else if (strcmp(argv[i], "--trace-size") == 0 && i+1 < argc) {
+            char *end;
+            long records = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || records <= 0 || records > MAX_TRACE_RECORDS) {
+                SDL_Log("--trace-size must be a number of records from 1 to %d", MAX_TRACE_RECORDS);
+                return SDL_APP_FAILURE;
+            }
+            trace_records = records;
+        }
+        else if (strcmp(argv[i], "--compare") == 0 && i+1 < argc)
+            compare_path = argv[++i];
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--single-thread") == 0)
+            single_thread = true;
+        else if (strcmp(argv[i], "--ff-speed") == 0 && i+1 < argc)
+            fast_forward_speed = atof(argv[++i]);
+        else if (strcmp(argv[i], "--hud") == 0)
+            hud_visible = true;
+        else if (strcmp(argv[i], "--frame-histogram") == 0 && i+1 < argc)
+            histogram_path = argv[++i];
+        else if (strcmp(argv[i], "--timeline") == 0 && i+1 < argc)
+            timeline_output = argv[++i];
+        else if (strcmp(argv[i], "--timeline-subsystems") == 0)
+            timeline_subsystems = true;
+        else if (strcmp(argv[i], "--timeline-size") == 0 && i+1 < argc)
+            timeline_events_size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--shm") == 0 && i+1 < argc)
+            shm_channel_name = argv[++i];
+        else if (strcmp(argv[i], "--link") == 0 && i+1 < argc)
+            link_name = argv[++i];
+        else if (strcmp(argv[i], "--link-relaxed") == 0)
+            link_relaxed = true;
+        else if (strcmp(argv[i], "--watch") == 0 && i+1 < argc)
+            gb_watch_add(strtol(argv[++i], NULL, 16), WATCH_CHANGES, 0);
+        else
+            rom_path = argv[i];
+    }
+    if (record_path && play_path) {
+        SDL_Log("Can't record and play back a movie at the same time");
+        return SDL_APP_FAILURE;
+    }
+    if (shm_channel_name)
+        headless = true; // The agent drives emulation, as fast as it asks for frames
+    if (headless && !play_path && !frame_limit && !compare_path && !shm_channel_name) {
+        SDL_Log("Headless runs need --play, --frames, --compare or --shm to know when to stop");
+        return SDL_APP_FAILURE;
+    }
 
     // SDL_SetAppMetadata("Example Renderer Primitives", "1.0", "com.example.renderer-primitives");
 
-    if (!SDL_Init(SDL_INIT_VIDEO)) {
+    if (!SDL_Init(headless ? 0 : SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
         SDL_Log("Couldn't initialize SDL: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
 
-    if (!SDL_CreateWindowAndRenderer("chip-8", SCR_WIDTH*PIXEL_SIZE, SCR_HEIGHT*PIXEL_SIZE, 0, &window, &renderer)) {
-        SDL_Log("Couldn't create window/renderer: %s", SDL_GetError());
-        return SDL_APP_FAILURE;
+    if (!headless) {
+        if (!SDL_CreateWindowAndRenderer("chip-8", SCR_WIDTH*PIXEL_SIZE, SCR_HEIGHT*PIXEL_SIZE, 0, &window, &renderer)) {
+            SDL_Log("Couldn't create window/renderer: %s", SDL_GetError());
+            return SDL_APP_FAILURE;
+        }
+
+        screen_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_XRGB8888, SDL_TEXTUREACCESS_STREAMING, SCR_WIDTH, SCR_HEIGHT);
+        if (screen_texture == NULL) {
+            SDL_Log("Couldn't create screen texture: %s", SDL_GetError());
+            return SDL_APP_FAILURE;
+        }
+        SDL_SetTextureScaleMode(screen_texture, SDL_SCALEMODE_NEAREST);
+
+        if (pacing_init() && display_matches_frame_rate(window))
+            vsync_enabled = SDL_SetRenderVSync(renderer, 1);
     }
 
-    init_memory("ROMS/"PROGRAM);
-    init_cpu_registers();
+    // The only instance, so the debugging features below can use the core's
+    // globals directly
+    size_t rom_size;
+    void *rom = SDL_LoadFile(rom_path, &rom_size);
+    core = gbcore_create();
+    if (rom == NULL || !gbcore_load_rom(core, rom, rom_size)) {
+        SDL_Log("Couldn't load ROM %s: %s", rom_path, rom ? "too small" : SDL_GetError());
+        SDL_free(rom);
+        return SDL_APP_FAILURE;
+    }
+    SDL_free(rom);
 
-    current_time = 0;
-    last_time = 0;
-    time_accumulator = 0;
+    if (play_path && !movie_start_playback(play_path))
+        return SDL_APP_FAILURE;
+    if (record_path && !movie_start_recording(record_path))
+        return SDL_APP_FAILURE;
+    gb_profiler_init();
+    if (guest_profile_path)
+        gb_guest_profiler_init(guest_sample_interval);
+    if (symbol_path)
+        gb_guest_profiler_load_symbols(symbol_path);
+    if (trace_path && !gb_tracer_init(trace_path, trace_records))
+        return SDL_APP_FAILURE;
+    if (compare_path && !gb_trace_compare_init(compare_path))
+        return SDL_APP_FAILURE;
+    if (timeline_output && !timeline_init(timeline_output, timeline_events_size))
+        return SDL_APP_FAILURE;
+    if (shm_channel_name && !shm_channel_open(shm_channel_name))
+        return SDL_APP_FAILURE;
+    if (link_name && !link_open_shared(link_name, link_relaxed))
+        return SDL_APP_FAILURE;
+    start_ticks = SDL_GetTicksNS();
 
     colors[0] = WHITE;
     colors[1] = LIGHT_GREY;
     colors[2] = DARK_GREY;
     colors[3] = BLACK;
+    for (int i = 0; i < 4; i++)
+        palette[i] = (colors[i].red << 16) | (colors[i].green << 8) | colors[i].blue;
+
+    if (!headless && !single_thread && !start_emulation_thread(emulate_frame))
+        return SDL_APP_FAILURE;
+    pacing_vsync = vsync_enabled && !emu_thread;
 
     return SDL_APP_CONTINUE;  /* carry on with the program! */
 }
 
+uint8_t button_for_scancode(SDL_Scancode scancode) {
+    switch (scancode) {
+        case SDL_SCANCODE_D: return BUTTON_RIGHT;
+        case SDL_SCANCODE_A: return BUTTON_LEFT;
+        case SDL_SCANCODE_W: return BUTTON_UP;
+        case SDL_SCANCODE_S: return BUTTON_DOWN;
+        case SDL_SCANCODE_K: return BUTTON_A;
+        case SDL_SCANCODE_J: return BUTTON_B;
+        case SDL_SCANCODE_C: return BUTTON_SELECT;
+        case SDL_SCANCODE_X: return BUTTON_START;
+        default: return 0;
+    }
+}
+
 /* This function runs when a new event (mouse input, keypresses, etc) occurs. */
 SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event)
 {
@@ -78,60 +225,165 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event)
         return SDL_APP_SUCCESS;  /* end the program, reporting success to the OS. */
     }
 
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.scancode == SDL_SCANCODE_F3)
+        hud_visible = !hud_visible;
+
+    if ((event->type == SDL_EVENT_KEY_DOWN || event->type == SDL_EVENT_KEY_UP) && !event->key.repeat
+        && event->key.scancode == SDL_SCANCODE_TAB)
+        set_fast_forward(FAST_FORWARD_HELD, event->key.down);
+
+    if (event->type == SDL_EVENT_KEY_DOWN && !event->key.repeat && event->key.scancode == SDL_SCANCODE_GRAVE)
+        toggle_fast_forward();
+
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.scancode == SDL_SCANCODE_F9)
+        SDL_SetAtomicInt(&trace_dump_requested, 1);
+
+    // Applied by emulate_frame, on the emulation thread if there is one
+    if ((event->type == SDL_EVENT_KEY_DOWN || event->type == SDL_EVENT_KEY_UP) && !event->key.repeat) {
+        uint8_t button = button_for_scancode(event->key.scancode);
+        if (button)
+            push_input(button, event->key.down);
+    }
+
     return SDL_APP_CONTINUE;  /* carry on with the program! */
 }
 
+// Applies queued input and runs one frame. Called from the emulation
+// thread, or from SDL_AppIterate when headless or with --single-thread.
+SDL_AppResult emulate_frame()
+{
+    if (shm_segment) {
+        enum shm_status status = shm_channel_begin_frame(100);
+        if (status == SHM_QUIT)
+            return SDL_APP_SUCCESS;
+        if (status == SHM_IDLE)
+            return SDL_APP_CONTINUE;
+    }
+
+    uint64_t phase_start = timeline_begin();
+    uint8_t buttons = gb_joypad_buttons, button;
+    bool pressed;
+    while (pop_input(&button, &pressed))
+        buttons = pressed ? buttons | button : buttons & ~button;
+    // Only latched at the frame boundary, the movie can't replay a press and
+    // release in the middle of a frame and the joypad interrupt it raised
+    if (movie_mode != MOVIE_PLAYING)
+        gb_set_joypad_buttons(buttons);
+    if (SDL_SetAtomicInt(&trace_dump_requested, 0) && gb_tracer_enabled) {
+        gb_tracer_dump();
+        SDL_Log("Dumped instruction trace to %s", gb_trace_dump_path);
+    }
+    movie_frame_input();
+    timeline_end(PHASE_INPUT, phase_start);
+
+    phase_start = timeline_begin();
+    if (gb_link_endpoint)
+        link_run_frame(); // Waits for the other side, not worth splitting up
+    else if (timeline_enabled && timeline_subsystems) {
+        // The clock reads slow the frame down, so only when asked for
+        struct subsystem_times times = {0};
+        gb_run_frame_timed(&times);
+        timeline_add_subsystems(phase_start, &times);
+    }
+    else
+        gbcore_run_frame(core);
+    timeline_end(PHASE_EMULATE, phase_start);
+    frame_count++;
+    timeline_next_frame();
+    struct watch_event events[64];
+    int event_count;
+    while ((event_count = gb_watch_take_events(events, 64)) > 0) {
+        for (int i = 0; i < event_count; i++)
+            SDL_Log("Frame %d: %04X %02X -> %02X", frame_count, events[i].address, events[i].old_value, events[i].new_value);
+    }
+    if (shm_segment)
+        shm_channel_end_frame();
+
+    if (gb_trace_compare_diverged)
+        return SDL_APP_FAILURE;
+    if (compare_path && headless && !gb_trace_compare_enabled)
+        return SDL_APP_SUCCESS; // Reference trace fully matched
+    if (frame_limit && frame_count >= frame_limit)
+        return SDL_APP_SUCCESS;
+    if (movie_finished()) {
+        if (headless)
+            return SDL_APP_SUCCESS;
+        movie_stop(); // Hand control back to the keyboard
+    }
+    return SDL_APP_CONTINUE;
+}
+
 /* This function runs once per frame, and is the heart of the program. */
 SDL_AppResult SDL_AppIterate(void *appstate)
-{    
-    current_time = SDL_GetTicks();
-    delta_time = current_time - last_time;
-    last_time = current_time;
-
-    printf("%f ", delta_time);
-    
-    while (frame_dot_counter < total_dots_per_frame) {
-        handle_input();
-        
-        // Fetch opcode
-        last_opcode = opcode;
-        opcode = memory[cpu.PC];
-        if (opcode == 0xCB) {
-            opcode = (opcode << 8) | memory[cpu.PC+1];
+{
+    struct frame_timing timing;
+    Uint64 frame_start = SDL_GetTicksNS();
+    uint64_t timeline_frame_start = timeline_begin();
+
+    uint8_t (*pixels)[SCR_WIDTH] = gb_frame_buffer;
+    bool fast = false;
+    if (emu_thread) {
+        SDL_AppResult result = SDL_GetAtomicInt(&emu_thread_result);
+        if (result != SDL_APP_CONTINUE)
+            return result;
+        // Vsync paces presenting, without it wait for the next frame
+        struct frame_slot *slot = vsync_enabled ? take_frame() : wait_frame(100);
+        if (slot == NULL && !vsync_enabled)
+            return SDL_APP_CONTINUE;
+        pixels = frame_slots[front_slot].pixels;
+        timing.emu_ns = frame_slots[front_slot].emu_ns;
+    }
+    else {
+        // While fast-forwarding, run frames until one is due to be shown
+        fast = !headless && fast_forward_active();
+        fast_forward_begin_frame(fast);
+        SDL_AppResult result = emulate_frame();
+        while (result == SDL_APP_CONTINUE && gb_ppu_skip_composition) {
+            fast_forward_pace();
+            fast_forward_begin_frame(fast);
+            result = emulate_frame();
+        }
+        if (result != SDL_APP_CONTINUE)
+            return result;
+        timing.emu_ns = SDL_GetTicksNS() - frame_start;
+        if (headless) {
+            timeline_end(PHASE_FRAME, timeline_frame_start);
+            return SDL_APP_CONTINUE;
         }
+    }
+    Uint64 render_start = SDL_GetTicksNS();
 
-        int M_cycles;
-        M_cycles = cpu_execute(opcode);
-        M_cycles += handle_interrupts();
-        if (lcd_enable())
-            ppu_execute(4*M_cycles);
-        frame_dot_counter += 4*M_cycles;
-
-        instruction_counter += 1;
-    }
-    frame_dot_counter = 0;
-    
-    
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);  /* dark gray, full alpha */
-    SDL_RenderClear(renderer);  /* start with a blank canvas. */
-
-      /* blue, full alpha */
-    SDL_FRect rect;
-    for (int i = 0; i < SCR_HEIGHT; i++) {
-        for (int j = 0; j < SCR_WIDTH; j++) {
-            struct color current_color = colors[frame_buffer[i][j]];
-            rect.x = j*PIXEL_SIZE;
-            rect.y = i*PIXEL_SIZE;
-            rect.w = PIXEL_SIZE;
-            rect.h = PIXEL_SIZE;
-            SDL_SetRenderDrawColor(renderer, current_color.red, current_color.green, current_color.blue, SDL_ALPHA_OPAQUE);
-            SDL_RenderFillRect(renderer, &rect);
+    uint64_t phase_start = timeline_begin();
+    Uint32 *texture_pixels;
+    int pitch;
+    if (SDL_LockTexture(screen_texture, NULL, (void **)&texture_pixels, &pitch)) {
+        for (int i = 0; i < SCR_HEIGHT; i++) {
+            Uint32 *row = (Uint32 *)((Uint8 *)texture_pixels + i * pitch);
+            for (int j = 0; j < SCR_WIDTH; j++)
+                row[j] = palette[pixels[i][j]];
         }
+        SDL_UnlockTexture(screen_texture);
     }
-    
-    
-    // SDL_RenderFillRect(renderer, &rect);
+    timeline_end(PHASE_TEXTURE_UPLOAD, phase_start);
+    phase_start = timeline_begin();
+    SDL_RenderTexture(renderer, screen_texture, NULL, NULL);
+    hud_draw(renderer);
+    timeline_end(PHASE_RENDER, phase_start);
+    Uint64 render_done = SDL_GetTicksNS();
+    timing.render_ns = render_done - render_start;
+
+    phase_start = timeline_begin();
     SDL_RenderPresent(renderer);
+    timeline_end(PHASE_PRESENT, phase_start);
+    timing.present_ns = SDL_GetTicksNS() - render_done;
+
+    if (!emu_thread && fast)
+        fast_forward_pace();
+    else if (!emu_thread)
+        pace_frame();
+    timing.frame_ns = SDL_GetTicksNS() - frame_start;
+    hud_record_frame(timing); // Shown in the next frame's overlay
+    timeline_end(PHASE_FRAME, timeline_frame_start);
 
     return SDL_APP_CONTINUE;  /* carry on with the program! */
 }
@@ -140,4 +392,29 @@ SDL_AppResult SDL_AppIterate(void *appstate)
 void SDL_AppQuit(void *appstate, SDL_AppResult result)
 {
     /* SDL will clean up the window/renderer for us. */
+    stop_emulation_thread();
+    shm_channel_close();
+    link_close_shared();
+    SDL_DestroyAudioStream(audio_stream);
+    movie_stop();
+    gb_profiler_report(stdout);
+    if (gb_tracer_enabled)
+        gb_tracer_dump();
+    if (histogram_path)
+        hud_write_histogram(histogram_path);
+    if (timeline_enabled)
+        write_timeline();
+    if (guest_profile_path) {
+        gb_guest_profiler_write_folded(guest_profile_path);
+        gb_guest_profiler_report(stdout, 20);
+    }
+
+    if (headless) {
+        double seconds = (SDL_GetTicksNS() - start_ticks) / 1e9;
+        printf("%d frames, %d instructions in %.3fs, frame hash %016llx, memory hash %016llx\n",
+            frame_count, gb_instruction_counter, seconds,
+            (unsigned long long)gb_xxh64(gb_frame_buffer, sizeof(gb_frame_buffer), 0),
+            (unsigned long long)gb_xxh64(gb_memory, sizeof(gb_memory), 0));
+    }
+    gbcore_destroy(core);
 }
\ No newline at end of file
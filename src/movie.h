@@ -0,0 +1,138 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gbmemory.h"
+#include "input.h"
+#include "state.h"
+
+// Movie file layout:
+//   struct movie_header
+//   struct gb_state      initial state the movie starts from
+//   uint8_t[frame_count] joypad bitmask applied at the start of each frame
+
+#define MOVIE_MAGIC "GBMV"
+#define MOVIE_VERSION 1
+
+enum movie_mode {
+    MOVIE_OFF,
+    MOVIE_RECORDING,
+    MOVIE_PLAYING
+};
+
+struct movie_header {
+    char magic[4];
+    uint32_t version;
+    uint64_t rom_hash;
+    uint32_t state_size;
+    uint32_t frame_count;
+};
+
+enum movie_mode movie_mode = MOVIE_OFF;
+struct movie_header movie_header;
+FILE *movie_file = NULL;
+uint8_t *movie_frames = NULL;
+uint32_t movie_frame = 0;
+
+// Starts recording from the current emulator state
+bool movie_start_recording(const char *path) {
+    movie_file = fopen(path, "wb");
+    if (movie_file == NULL) {
+        printf("Could not open movie file %s!\n", path);
+        return false;
+    }
+
+    memcpy(movie_header.magic, MOVIE_MAGIC, 4);
+    movie_header.version = MOVIE_VERSION;
+    movie_header.rom_hash = gb_rom_hash;
+    movie_header.state_size = sizeof(struct gb_state);
+    movie_header.frame_count = 0;
+
+    struct gb_state *state = calloc(1, sizeof(struct gb_state));
+    gb_save_state(state);
+    fwrite(&movie_header, sizeof(movie_header), 1, movie_file);
+    fwrite(state, sizeof(struct gb_state), 1, movie_file);
+    free(state);
+
+    movie_frame = 0;
+    movie_mode = MOVIE_RECORDING;
+    return true;
+}
+
+// Loads a movie and restores its initial state. The ROM must already be
+// loaded so its hash can be checked.
+bool movie_start_playback(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Could not open movie file %s!\n", path);
+        return false;
+    }
+
+    if (fread(&movie_header, sizeof(movie_header), 1, file) != 1
+        || memcmp(movie_header.magic, MOVIE_MAGIC, 4) != 0
+        || movie_header.version != MOVIE_VERSION
+        || movie_header.state_size != sizeof(struct gb_state)) {
+        printf("%s is not a compatible movie file!\n", path);
+        fclose(file);
+        return false;
+    }
+    if (movie_header.rom_hash != gb_rom_hash) {
+        printf("Movie was recorded with a different ROM (%016llx, loaded %016llx)!\n",
+            (unsigned long long)movie_header.rom_hash, (unsigned long long)gb_rom_hash);
+        fclose(file);
+        return false;
+    }
+
+    struct gb_state *state = malloc(sizeof(struct gb_state));
+    movie_frames = malloc(movie_header.frame_count + 1);
+    bool complete = fread(state, sizeof(struct gb_state), 1, file) == 1
+        && fread(movie_frames, 1, movie_header.frame_count, file) == movie_header.frame_count;
+    fclose(file);
+    if (!complete) {
+        printf("Movie file %s is truncated!\n", path);
+        free(state);
+        return false;
+    }
+
+    gb_load_state(state);
+    free(state);
+    movie_frame = 0;
+    movie_mode = MOVIE_PLAYING;
+    return true;
+}
+
+// Called at the start of every frame, before any instruction runs. The
+// recorded mask is all the input a frame gets, so while recording, buttons
+// must only change through one gb_set_joypad_buttons call just before this.
+void movie_frame_input() {
+    if (movie_mode == MOVIE_RECORDING) {
+        fputc(gb_joypad_buttons, movie_file);
+        movie_frame++;
+    }
+    else if (movie_mode == MOVIE_PLAYING && movie_frame < movie_header.frame_count) {
+        gb_set_joypad_buttons(movie_frames[movie_frame]);
+        movie_frame++;
+    }
+}
+
+bool movie_finished() {
+    return movie_mode == MOVIE_PLAYING && movie_frame >= movie_header.frame_count;
+}
+
+void movie_stop() {
+    if (movie_mode == MOVIE_RECORDING) {
+        // Patch in the final frame count
+        movie_header.frame_count = movie_frame;
+        fseek(movie_file, 0, SEEK_SET);
+        fwrite(&movie_header, sizeof(movie_header), 1, movie_file);
+        fclose(movie_file);
+        movie_file = NULL;
+    }
+    free(movie_frames);
+    movie_frames = NULL;
+    movie_mode = MOVIE_OFF;
+}
+
+#endif
\ No newline at end of file
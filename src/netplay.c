@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "hash.h"
+
+// One netplay peer without a window. Local input is a pseudo-random button
+// sequence from --seed, holding each combination for a few frames, which
+// is enough to exercise prediction and rollback. Run two with swapped
+// ports; with the same frame count both print the same hashes.
+
+#ifdef _WIN32
+int main(int argc, char *argv[]) {
+    fprintf(stderr, "Netplay needs POSIX sockets\n");
+    return 1;
+}
+#else
+#include "netplay.h"
+
+uint32_t random_state = 1;
+
+uint32_t next_random() {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 16;
+}
+
+int main(int argc, char *argv[]) {
+    char *rom_path = NULL;
+    char *stats_path = NULL;
+    char *remote_host = "127.0.0.1";
+    int ports[2] = {0, 0};
+    int port_count = 0;
+    int frames = 600;
+    int input_delay = 2;
+    int max_rollback = 8;
+    int latency_ms = 0;
+    bool paced = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i+1 < argc)
+            frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--delay") == 0 && i+1 < argc)
+            input_delay = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rollback") == 0 && i+1 < argc)
+            max_rollback = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--latency") == 0 && i+1 < argc)
+            latency_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i+1 < argc)
+            random_state = strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--host") == 0 && i+1 < argc)
+            remote_host = argv[++i];
+        else if (strcmp(argv[i], "--stats") == 0 && i+1 < argc)
+            stats_path = argv[++i];
+        else if (strcmp(argv[i], "--unpaced") == 0)
+            paced = false;
+        else if (rom_path == NULL)
+            rom_path = argv[i];
+        else if (port_count < 2)
+            ports[port_count++] = atoi(argv[i]);
+    }
+    if (rom_path == NULL || port_count < 2) {
+        fprintf(stderr, "usage: netplay rom.gb local_port remote_port [--host 127.0.0.1] [--frames N] [--delay N] "
+            "[--rollback N] [--latency ms] [--seed N] [--stats out.csv] [--unpaced]\n");
+        return 1;
+    }
+
+    if (!gb_init_memory(rom_path))
+        return 1;
+    gb_init_cpu_registers();
+    struct netplay *netplay = netplay_open(ports[0], remote_host, ports[1], input_delay, max_rollback, latency_ms);
+    if (netplay == NULL)
+        return 1;
+    FILE *stats_file = NULL;
+    if (stats_path) {
+        stats_file = fopen(stats_path, "w");
+        if (stats_file == NULL) {
+            perror(stats_path);
+            return 1;
+        }
+        fprintf(stats_file, "frame,rollback_frames,resimulation_us,confirmed_remote\n");
+    }
+
+    uint64_t frame_ns = (uint64_t)(1e9 / 59.7275);
+    uint64_t start = gb_host_time_ns();
+    uint8_t buttons = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        if (next_random() % 8 == 0)
+            buttons = next_random() & 0xFF;
+        if (!netplay_frame(netplay, buttons)) {
+            fprintf(stderr, "Remote stopped answering at frame %d\n", frame);
+            return 1;
+        }
+        if (stats_file)
+            fprintf(stats_file, "%d,%d,%.1f,%d\n", frame, netplay->last_rollback_frames,
+                netplay->last_resimulation_ns / 1e3, netplay->confirmed_remote);
+        if (paced) {
+            uint64_t due = start + (frame + 1) * frame_ns;
+            uint64_t now = gb_host_time_ns();
+            if (due > now)
+                usleep((due - now) / 1000);
+        }
+    }
+    if (!netplay_finish(netplay)) {
+        fprintf(stderr, "Remote stopped answering before the last inputs arrived\n");
+        return 1;
+    }
+    double seconds = (gb_host_time_ns() - start) / 1e9;
+
+    struct netplay_stats *stats = &netplay->stats;
+    printf("%d frames in %.2fs, %d rollbacks (%d frames resimulated, max %d), %d over a frame's budget, %d stalls (%.1f ms)\n",
+        stats->frames, seconds, stats->rollbacks, stats->resimulated_frames, stats->max_rollback_frames,
+        stats->over_budget, stats->stalls, stats->stall_ns / 1e6);
+    if (stats->rollbacks)
+        printf("resimulation %.1f us per rollback, %.1f us per frame, max %.1f us\n",
+            stats->resimulation_ns / 1e3 / stats->rollbacks, stats->resimulation_ns / 1e3 / stats->resimulated_frames,
+            stats->max_resimulation_ns / 1e3);
+    printf("frame hash %016llx, memory hash %016llx\n",
+        (unsigned long long)gb_xxh64(gb_frame_buffer, sizeof(gb_frame_buffer), 0),
+        (unsigned long long)gb_xxh64(gb_memory, sizeof(gb_memory), 0));
+    if (stats_file)
+        fclose(stats_file);
+    netplay_close(netplay);
+    return 0;
+}
+#endif
@@ -0,0 +1,288 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "emulator.h"
+#include "input.h"
+#include "state.h"
+#include "hosttime.h"
+
+// Rollback netplay between two instances over UDP. Both run the same ROM
+// from power-on, and every frame's joypad is the OR of both players'
+// buttons, so both stay in lockstep as long as they agree on the inputs.
+// Local input is scheduled input_delay frames ahead and sent with the
+// previous NETPLAY_WINDOW frames' inputs, so a lost packet is covered by
+// the next one. A frame whose remote input hasn't arrived yet runs with
+// the last one received; when the real input differs the emulator loads
+// the state saved before that frame and runs forward again. A peer more
+// than max_rollback frames ahead of the remote's inputs waits.
+
+#define NETPLAY_MAGIC 0x504E4247 // "GBNP"
+#define NETPLAY_WINDOW 32
+#define NETPLAY_HISTORY 256
+#define NETPLAY_MAX_ROLLBACK 60
+#define NETPLAY_MAX_DELAY 30
+#define NETPLAY_TIMEOUT_NS 5000000000ull
+#define NETPLAY_RESEND_NS 10000000ull
+#define NETPLAY_MAX_QUEUED 256
+
+struct netplay_packet {
+    uint32_t magic;
+    int32_t frame;          // Frame of inputs[NETPLAY_WINDOW-1]
+    int32_t ack;            // Newest frame of the receiver's inputs the sender has
+    uint8_t inputs[NETPLAY_WINDOW];
+};
+
+struct netplay_stats {
+    int frames;
+    int rollbacks;
+    int resimulated_frames;
+    int max_rollback_frames;
+    int over_budget;        // Rollbacks that took longer than a Game Boy frame
+    int stalls;
+    uint64_t resimulation_ns;
+    uint64_t max_resimulation_ns;
+    uint64_t stall_ns;
+};
+
+struct netplay_delayed_packet {
+    uint64_t due_ns;
+    struct netplay_packet packet;
+};
+
+struct netplay {
+    int socket;
+    struct sockaddr_in remote;
+    int input_delay;
+    int max_rollback;
+    uint64_t latency_ns;    // Added to every packet sent, to test rollback locally
+
+    int frame;              // Next frame to run
+    int confirmed_remote;   // Newest frame with the remote's real input
+    int remote_ack;
+    uint8_t local_inputs[NETPLAY_HISTORY];
+    uint8_t remote_inputs[NETPLAY_HISTORY];
+    uint8_t used_remote[NETPLAY_HISTORY]; // Remote input each frame last ran with
+    int mispredicted;       // Oldest frame that ran with a wrong prediction, -1 if none
+    struct gb_state *states; // Before each of the last max_rollback + 2 frames
+
+    struct netplay_delayed_packet queue[NETPLAY_MAX_QUEUED];
+    int queued;
+    uint64_t last_send_ns;
+
+    struct netplay_stats stats;
+    int last_rollback_frames; // For the frame just run
+    uint64_t last_resimulation_ns;
+};
+
+// Binds 127.0.0.1:local_port (or any address when remote_host isn't
+// loopback) and sends to remote_host:remote_port. The emulator must be
+// at the state both peers start from.
+struct netplay *netplay_open(int local_port, const char *remote_host, int remote_port,
+        int input_delay, int max_rollback, int latency_ms) {
+    if (input_delay < 0 || input_delay > NETPLAY_MAX_DELAY || max_rollback < 0 || max_rollback > NETPLAY_MAX_ROLLBACK) {
+        fprintf(stderr, "Input delay must be 0-%d and rollback 0-%d frames\n", NETPLAY_MAX_DELAY, NETPLAY_MAX_ROLLBACK);
+        return NULL;
+    }
+    struct netplay *netplay = calloc(1, sizeof(struct netplay));
+    netplay->states = malloc((max_rollback + 2) * sizeof(struct gb_state));
+    netplay->input_delay = input_delay;
+    netplay->max_rollback = max_rollback;
+    netplay->latency_ns = (uint64_t)latency_ms * 1000000;
+    netplay->confirmed_remote = input_delay - 1; // Frames before the delay run with no input
+    netplay->remote_ack = input_delay - 1;
+    netplay->mispredicted = -1;
+
+    netplay->remote.sin_family = AF_INET;
+    netplay->remote.sin_port = htons(remote_port);
+    if (inet_pton(AF_INET, remote_host, &netplay->remote.sin_addr) != 1) {
+        fprintf(stderr, "Bad remote address %s\n", remote_host);
+        free(netplay->states);
+        free(netplay);
+        return NULL;
+    }
+    struct sockaddr_in local = {0};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(local_port);
+    local.sin_addr.s_addr = strcmp(remote_host, "127.0.0.1") == 0 ? htonl(INADDR_LOOPBACK) : htonl(INADDR_ANY);
+    netplay->socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (netplay->socket < 0 || bind(netplay->socket, (struct sockaddr *)&local, sizeof(local)) != 0) {
+        perror("netplay socket");
+        if (netplay->socket >= 0)
+            close(netplay->socket);
+        free(netplay->states);
+        free(netplay);
+        return NULL;
+    }
+    return netplay;
+}
+
+void netplay_close(struct netplay *netplay) {
+    close(netplay->socket);
+    free(netplay->states);
+    free(netplay);
+}
+
+void flush_delayed_packets(struct netplay *netplay) {
+    uint64_t now = gb_host_time_ns();
+    int kept = 0;
+    for (int i = 0; i < netplay->queued; i++) {
+        if (netplay->queue[i].due_ns <= now)
+            sendto(netplay->socket, &netplay->queue[i].packet, sizeof(struct netplay_packet), 0,
+                (struct sockaddr *)&netplay->remote, sizeof(netplay->remote));
+        else
+            netplay->queue[kept++] = netplay->queue[i];
+    }
+    netplay->queued = kept;
+}
+
+// Sends the newest scheduled local input with the window before it
+void send_inputs(struct netplay *netplay) {
+    struct netplay_packet packet = {NETPLAY_MAGIC, netplay->frame + netplay->input_delay, netplay->confirmed_remote};
+    for (int i = 0; i < NETPLAY_WINDOW; i++) {
+        int frame = packet.frame - (NETPLAY_WINDOW - 1) + i;
+        packet.inputs[i] = frame < 0 ? 0 : netplay->local_inputs[frame % NETPLAY_HISTORY];
+    }
+    netplay->last_send_ns = gb_host_time_ns();
+    if (netplay->latency_ns && netplay->queued < NETPLAY_MAX_QUEUED)
+        netplay->queue[netplay->queued++] = (struct netplay_delayed_packet){netplay->last_send_ns + netplay->latency_ns, packet};
+    else if (!netplay->latency_ns)
+        sendto(netplay->socket, &packet, sizeof(packet), 0, (struct sockaddr *)&netplay->remote, sizeof(netplay->remote));
+    flush_delayed_packets(netplay);
+}
+
+// Reads every pending packet, waiting up to timeout_ms for the first
+void receive_inputs(struct netplay *netplay, int timeout_ms) {
+    struct pollfd poll_fd = {netplay->socket, POLLIN, 0};
+    if (timeout_ms > 0 && poll(&poll_fd, 1, timeout_ms) <= 0)
+        return;
+
+    struct netplay_packet packet;
+    while (recv(netplay->socket, &packet, sizeof(packet), MSG_DONTWAIT) == sizeof(packet)) {
+        if (packet.magic != NETPLAY_MAGIC)
+            continue;
+        if (packet.ack > netplay->remote_ack)
+            netplay->remote_ack = packet.ack;
+        // Only extend the confirmed inputs without gaps
+        for (int frame = netplay->confirmed_remote + 1; frame <= packet.frame; frame++) {
+            int index = frame - (packet.frame - (NETPLAY_WINDOW - 1));
+            if (index < 0)
+                break;
+            uint8_t input = packet.inputs[index];
+            netplay->remote_inputs[frame % NETPLAY_HISTORY] = input;
+            netplay->confirmed_remote = frame;
+            if (frame < netplay->frame && netplay->used_remote[frame % NETPLAY_HISTORY] != input
+                    && (netplay->mispredicted < 0 || frame < netplay->mispredicted))
+                netplay->mispredicted = frame;
+        }
+    }
+}
+
+// Remote input for a frame, predicted as the last one received
+uint8_t remote_input(struct netplay *netplay, int frame) {
+    if (frame <= netplay->confirmed_remote)
+        return netplay->remote_inputs[frame % NETPLAY_HISTORY];
+    return netplay->remote_inputs[netplay->confirmed_remote % NETPLAY_HISTORY];
+}
+
+void simulate_frame(struct netplay *netplay, int frame) {
+    gb_save_state(&netplay->states[frame % (netplay->max_rollback + 2)]);
+    uint8_t remote = remote_input(netplay, frame);
+    netplay->used_remote[frame % NETPLAY_HISTORY] = remote;
+    gb_set_joypad_buttons(netplay->local_inputs[frame % NETPLAY_HISTORY] | remote);
+    gb_run_frame();
+}
+
+// Loads the state before the oldest mispredicted frame and runs back up
+// to the current one with the inputs known now
+void roll_back(struct netplay *netplay) {
+    if (netplay->mispredicted < 0)
+        return;
+    uint64_t start = gb_host_time_ns();
+    int from = netplay->mispredicted;
+    netplay->mispredicted = -1;
+    gb_load_state(&netplay->states[from % (netplay->max_rollback + 2)]);
+    for (int frame = from; frame < netplay->frame; frame++)
+        simulate_frame(netplay, frame);
+
+    uint64_t elapsed = gb_host_time_ns() - start;
+    int frames = netplay->frame - from;
+    struct netplay_stats *stats = &netplay->stats;
+    stats->rollbacks++;
+    stats->resimulated_frames += frames;
+    stats->resimulation_ns += elapsed;
+    if (frames > stats->max_rollback_frames)
+        stats->max_rollback_frames = frames;
+    if (elapsed > stats->max_resimulation_ns)
+        stats->max_resimulation_ns = elapsed;
+    if (elapsed > (uint64_t)(1e9 / 59.7275))
+        stats->over_budget++;
+    netplay->last_rollback_frames += frames;
+    netplay->last_resimulation_ns += elapsed;
+}
+
+// Runs one frame with the local player's buttons, rolling back first if
+// remote input contradicted a prediction. Returns false if the remote
+// stopped answering.
+bool netplay_frame(struct netplay *netplay, uint8_t local_buttons) {
+    netplay->last_rollback_frames = 0;
+    netplay->last_resimulation_ns = 0;
+    netplay->local_inputs[(netplay->frame + netplay->input_delay) % NETPLAY_HISTORY] = local_buttons;
+    send_inputs(netplay);
+    receive_inputs(netplay, 0);
+
+    // Too far ahead to roll back, wait for the remote to catch up
+    if (netplay->frame - netplay->confirmed_remote > netplay->max_rollback) {
+        uint64_t start = gb_host_time_ns();
+        netplay->stats.stalls++;
+        while (netplay->frame - netplay->confirmed_remote > netplay->max_rollback) {
+            if (gb_host_time_ns() - start > NETPLAY_TIMEOUT_NS)
+                return false;
+            if (gb_host_time_ns() - netplay->last_send_ns > NETPLAY_RESEND_NS)
+                send_inputs(netplay);
+            flush_delayed_packets(netplay);
+            receive_inputs(netplay, 1);
+        }
+        netplay->stats.stall_ns += gb_host_time_ns() - start;
+    }
+
+    roll_back(netplay);
+    simulate_frame(netplay, netplay->frame);
+    netplay->frame++;
+    netplay->stats.frames++;
+    return true;
+}
+
+// Waits until both peers have each other's inputs for every frame run and
+// corrects the last predictions, so both end on the same state
+bool netplay_finish(struct netplay *netplay) {
+    uint64_t start = gb_host_time_ns();
+    while (netplay->confirmed_remote < netplay->frame - 1 || netplay->remote_ack < netplay->frame - 1) {
+        if (gb_host_time_ns() - start > NETPLAY_TIMEOUT_NS)
+            return false;
+        if (gb_host_time_ns() - netplay->last_send_ns > NETPLAY_RESEND_NS)
+            send_inputs(netplay);
+        flush_delayed_packets(netplay);
+        receive_inputs(netplay, 1);
+    }
+    roll_back(netplay);
+    // The remote may still be waiting for our acknowledgement
+    for (int i = 0; i < 3; i++)
+        send_inputs(netplay);
+    while (netplay->queued > 0) {
+        flush_delayed_packets(netplay);
+        usleep(1000);
+    }
+    return true;
+}
+
+#endif
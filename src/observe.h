@@ -0,0 +1,125 @@
+#ifndef OBSERVE_H
+#define OBSERVE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ppu.h"
+
+// Converts the frame buffer's color indices into 8-bit grayscale for
+// agents, written straight into caller buffers. Shades go through BGP like
+// the LCD does, shade 0 is white (255) and shade 3 black (0). Uses SSE2
+// where the compiler targets it (all x86-64), -DOBSERVE_SCALAR forces the
+// plain loops.
+
+#if defined(__SSE2__) && !defined(OBSERVE_SCALAR)
+#define OBSERVE_SSE2
+#include <emmintrin.h>
+#endif
+
+void observe_palette(uint8_t bgp, uint8_t gray[4]) {
+    for (int i = 0; i < 4; i++)
+        gray[i] = 255 - ((bgp >> (i * 2)) & 3) * 85;
+}
+
+#ifdef OBSERVE_SSE2
+// 16 color indices to gray, SSE2 has no byte shuffle so select per index
+__m128i gray16(__m128i indices, const __m128i gray[4]) {
+    __m128i out = _mm_and_si128(_mm_cmpeq_epi8(indices, _mm_setzero_si128()), gray[0]);
+    out = _mm_or_si128(out, _mm_and_si128(_mm_cmpeq_epi8(indices, _mm_set1_epi8(1)), gray[1]));
+    out = _mm_or_si128(out, _mm_and_si128(_mm_cmpeq_epi8(indices, _mm_set1_epi8(2)), gray[2]));
+    return _mm_or_si128(out, _mm_and_si128(_mm_cmpeq_epi8(indices, _mm_set1_epi8(3)), gray[3]));
+}
+
+void load_palette(uint8_t bgp, __m128i gray[4]) {
+    uint8_t shades[4];
+    observe_palette(bgp, shades);
+    for (int i = 0; i < 4; i++)
+        gray[i] = _mm_set1_epi8((char)shades[i]);
+}
+#endif
+
+void gray_row(const uint8_t *in, uint8_t bgp, uint8_t *out, int count) {
+    int i = 0;
+#ifdef OBSERVE_SSE2
+    __m128i gray[4];
+    load_palette(bgp, gray);
+    for (; i + 16 <= count; i += 16)
+        _mm_storeu_si128((__m128i *)(out + i), gray16(_mm_loadu_si128((const __m128i *)(in + i)), gray));
+#endif
+    uint8_t shades[4];
+    observe_palette(bgp, shades);
+    for (; i < count; i++)
+        out[i] = shades[in[i] & 3];
+}
+
+// SCR_WIDTH x SCR_HEIGHT bytes
+void observe_gray(uint8_t bgp, uint8_t *out) {
+    gray_row(&gb_frame_buffer[0][0], bgp, out, SCR_WIDTH * SCR_HEIGHT);
+}
+
+// width x height bytes from (x, y), which must lie inside the screen
+void observe_crop(uint8_t bgp, int x, int y, int width, int height, uint8_t *out) {
+    for (int row = 0; row < height; row++)
+        gray_row(&gb_frame_buffer[y + row][x], bgp, out + row * width, width);
+}
+
+// Rounded mean of every factor x factor block, factor 2 or 4, writing
+// (SCR_WIDTH / factor) x (SCR_HEIGHT / factor) bytes
+void observe_downsample(uint8_t bgp, int factor, uint8_t *out) {
+    int width = SCR_WIDTH / factor;
+#ifdef OBSERVE_SSE2
+    __m128i gray[4];
+    load_palette(bgp, gray);
+    __m128i ones = _mm_set1_epi16(1);
+    for (int y = 0; y < SCR_HEIGHT / factor; y++) {
+        for (int x = 0; x < SCR_WIDTH; x += 16) {
+            // Column sums of the block's rows as 16-bit
+            __m128i low = _mm_setzero_si128(), high = _mm_setzero_si128();
+            for (int row = 0; row < factor; row++) {
+                __m128i pixels = gray16(_mm_loadu_si128((const __m128i *)&gb_frame_buffer[y * factor + row][x]), gray);
+                low = _mm_add_epi16(low, _mm_unpacklo_epi8(pixels, _mm_setzero_si128()));
+                high = _mm_add_epi16(high, _mm_unpackhi_epi8(pixels, _mm_setzero_si128()));
+            }
+            // Adjacent column pairs as 32-bit
+            low = _mm_madd_epi16(low, ones);
+            high = _mm_madd_epi16(high, ones);
+            __m128i sums = _mm_packs_epi32(low, high);
+            if (factor == 2) {
+                sums = _mm_srli_epi16(_mm_add_epi16(sums, _mm_set1_epi16(2)), 2);
+                _mm_storel_epi64((__m128i *)(out + y * width + x / 2), _mm_packus_epi16(sums, sums));
+            }
+            else {
+                sums = _mm_madd_epi16(sums, ones);
+                sums = _mm_srli_epi32(_mm_add_epi32(sums, _mm_set1_epi32(8)), 4);
+                sums = _mm_packs_epi32(sums, sums);
+                uint32_t four = _mm_cvtsi128_si32(_mm_packus_epi16(sums, sums));
+                memcpy(out + y * width + x / 4, &four, 4);
+            }
+        }
+    }
+#else
+    uint8_t shades[4];
+    observe_palette(bgp, shades);
+    int area = factor * factor;
+    for (int y = 0; y < SCR_HEIGHT / factor; y++) {
+        for (int x = 0; x < width; x++) {
+            int sum = 0;
+            for (int row = 0; row < factor; row++) {
+                for (int column = 0; column < factor; column++)
+                    sum += shades[gb_frame_buffer[y * factor + row][x * factor + column] & 3];
+            }
+            out[y * width + x] = (sum + area / 2) / area;
+        }
+    }
+#endif
+}
+
+// Stack of the last frames_per_stack observations of frame_size bytes,
+// oldest first. Drops the oldest and returns where to write the newest.
+uint8_t *observe_stack_shift(uint8_t *stack, int frames_per_stack, int frame_size) {
+    memmove(stack, stack + frame_size, (size_t)(frames_per_stack - 1) * frame_size);
+    return stack + (size_t)(frames_per_stack - 1) * frame_size;
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <SDL3/SDL.h>
+#include <stdint.h>
+
+#include "timeline.h"
+
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_CHANNELS 2
+#define AUDIO_FRAME_BYTES (AUDIO_CHANNELS * sizeof(int16_t))
+#define MAX_SAMPLES_PER_FRAME 1024
+
+#define GB_FRAME_RATE (4194304.0 / 70224.0) // ~59.73 Hz
+#define SAMPLES_PER_FRAME (AUDIO_SAMPLE_RATE / GB_FRAME_RATE)
+
+#define PACING_TARGET_LATENCY_FRAMES 3
+#define PACING_MAX_RATIO_ADJUST 0.005 // +-0.5% is inaudible as pitch change
+// Ratio change per frame of queue error. 60 Hz vsync needs +0.45%, which
+// this reaches 0.27 frames above target, and the clamp at 0.3 frames.
+#define PACING_RATE_GAIN (0.05 / PACING_TARGET_LATENCY_FRAMES)
+#define PACING_AVERAGE_WEIGHT 0.05
+// With vsync pacing the frames, sleeping only this far above target keeps
+// the sleeps out of the controller's band
+#define PACING_VSYNC_SLEEP_MARGIN_FRAMES 2
+
+// APU output for the current frame. Sound isn't emulated yet so this stays
+// silent, but pushing it still lets the audio device act as the clock.
+int16_t audio_samples[AUDIO_CHANNELS * MAX_SAMPLES_PER_FRAME];
+
+SDL_AudioStream *audio_stream = NULL;
+double sample_accumulator = 0;
+double queued_average = 0;
+double resample_ratio = 1.0;
+Uint64 next_frame_deadline = 0;
+bool pacing_vsync = false; // Vsync blocks each frame, set when emulating on the main thread with it
+
+// Opens the audio device used as master clock. Returns false and falls back
+// to timer pacing if there's no audio device.
+bool pacing_init() {
+    SDL_AudioSpec spec = {SDL_AUDIO_S16, AUDIO_CHANNELS, AUDIO_SAMPLE_RATE};
+    audio_stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, NULL, NULL);
+    next_frame_deadline = SDL_GetTicksNS();
+    if (audio_stream == NULL) {
+        SDL_Log("Couldn't open audio device, using timer pacing: %s", SDL_GetError());
+        return false;
+    }
+    queued_average = PACING_TARGET_LATENCY_FRAMES * SAMPLES_PER_FRAME;
+    SDL_ResumeAudioStreamDevice(audio_stream);
+    return true;
+}
+
+int queued_sample_frames() {
+    return SDL_GetAudioStreamQueued(audio_stream) / AUDIO_FRAME_BYTES;
+}
+
+// Sleeps until the next frame is due when there is no audio device
+void timer_pace_frame() {
+    Uint64 frame_ns = (Uint64)(1e9 / GB_FRAME_RATE);
+    Uint64 now = SDL_GetTicksNS();
+
+    next_frame_deadline += frame_ns;
+    if (next_frame_deadline > now)
+        SDL_DelayNS(next_frame_deadline - now);
+    else if (now - next_frame_deadline > 4 * frame_ns)
+        next_frame_deadline = now; // Too far behind (breakpoint, window drag), don't try to catch up
+}
+
+// Called once per emulated frame. Pushes the frame's samples, nudges the
+// resampling ratio to hold the queue at the target latency and sleeps while
+// the queue is over target (with vsync, PACING_VSYNC_SLEEP_MARGIN_FRAMES over).
+void pace_frame() {
+    uint64_t start = timeline_begin();
+    if (audio_stream == NULL) {
+        timer_pace_frame();
+        timeline_end(PHASE_PACING_WAIT, start);
+        return;
+    }
+
+    sample_accumulator += SAMPLES_PER_FRAME;
+    int samples = (int)sample_accumulator;
+    sample_accumulator -= samples;
+    SDL_PutAudioStreamData(audio_stream, audio_samples, samples * AUDIO_FRAME_BYTES);
+
+    // Dynamic rate control: the device drains faster when the queue is above
+    // target and slower when below. A clock mismatch within the clamp, like
+    // 59.73 Hz emulation on a 60 Hz vsync, settles a fraction of a frame
+    // off target, well below where the loop further down starts sleeping
+    // with vsync. Without it that loop holds the queue at target.
+    double target = PACING_TARGET_LATENCY_FRAMES * SAMPLES_PER_FRAME;
+    int queued = queued_sample_frames();
+    queued_average += (queued - queued_average) * PACING_AVERAGE_WEIGHT;
+
+    double adjust = (queued_average - target) / SAMPLES_PER_FRAME * PACING_RATE_GAIN;
+    if (adjust > PACING_MAX_RATIO_ADJUST) adjust = PACING_MAX_RATIO_ADJUST;
+    if (adjust < -PACING_MAX_RATIO_ADJUST) adjust = -PACING_MAX_RATIO_ADJUST;
+    resample_ratio = 1.0 + adjust;
+    SDL_SetAudioStreamFrequencyRatio(audio_stream, (float)resample_ratio);
+    timeline_end(PHASE_AUDIO_PUSH, start);
+    start = timeline_begin();
+
+    // Audio is the master clock: block for as long as the excess takes to play
+    double sleep_threshold = target + (pacing_vsync ? PACING_VSYNC_SLEEP_MARGIN_FRAMES * SAMPLES_PER_FRAME : 0);
+    while (queued > sleep_threshold) {
+        double excess = queued - sleep_threshold;
+        Uint64 sleep_ns = (Uint64)(excess / (AUDIO_SAMPLE_RATE * resample_ratio) * 1e9);
+        SDL_DelayNS(sleep_ns > 1000000 ? sleep_ns : 1000000);
+        queued = queued_sample_frames();
+    }
+    timeline_end(PHASE_PACING_WAIT, start);
+}
+
+// Vsync only helps when the display runs close to the Game Boy rate, the
+// ratio adjustment can then absorb the difference (60 Hz is 0.45% off).
+bool display_matches_frame_rate(SDL_Window *window) {
+    const SDL_DisplayMode *display_mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+    if (display_mode == NULL || display_mode->refresh_rate <= 0)
+        return false;
+    double difference = (display_mode->refresh_rate - GB_FRAME_RATE) / GB_FRAME_RATE;
+    return difference < PACING_MAX_RATIO_ADJUST && difference > -PACING_MAX_RATIO_ADJUST;
+}
+
+#endif
\ No newline at end of file
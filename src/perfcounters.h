@@ -0,0 +1,134 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Hardware performance counters around a block of host code, through
+// perf_event_open on Linux. Counters the CPU, kernel or perf_event_paranoid
+// don't allow are left out, everywhere else none are available.
+
+enum perf_counter_id {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_L1I_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+const char *perf_counter_names[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "branch-misses", "L1d-misses", "L1i-misses"
+};
+
+struct perf_counters {
+    int fds[PERF_COUNTER_COUNT];
+    bool available[PERF_COUNTER_COUNT];
+    uint64_t values[PERF_COUNTER_COUNT];
+};
+
+#ifdef __linux__
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+int open_perf_event(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+uint64_t cache_miss_config(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// Returns false if no counter could be opened
+bool perf_counters_open(struct perf_counters *counters) {
+    counters->fds[PERF_CYCLES] = open_perf_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counters->fds[PERF_INSTRUCTIONS] = open_perf_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counters->fds[PERF_BRANCH_MISSES] = open_perf_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    counters->fds[PERF_L1D_MISSES] = open_perf_event(PERF_TYPE_HW_CACHE, cache_miss_config(PERF_COUNT_HW_CACHE_L1D));
+    counters->fds[PERF_L1I_MISSES] = open_perf_event(PERF_TYPE_HW_CACHE, cache_miss_config(PERF_COUNT_HW_CACHE_L1I));
+
+    static bool warned = false;
+    bool any = false;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        counters->available[i] = counters->fds[i] >= 0;
+        counters->values[i] = 0;
+        any |= counters->available[i];
+    }
+    if (!any && !warned) {
+        fprintf(stderr, "No hardware counters available: %s\n", strerror(errno));
+        warned = true;
+    }
+    return any;
+}
+
+void perf_counters_start(struct perf_counters *counters) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counters->available[i]) {
+            ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+// Stops the counters and stores their values, scaled up if the kernel had to
+// multiplex them with other events. A counter that can't be read becomes
+// unavailable.
+void perf_counters_stop(struct perf_counters *counters) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counters->available[i])
+            ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        uint64_t data[3]; // value, time enabled, time running
+        counters->values[i] = 0;
+        if (!counters->available[i])
+            continue;
+        if (read(counters->fds[i], data, sizeof(data)) != sizeof(data)) {
+            counters->available[i] = false;
+            continue;
+        }
+        if (data[2] > 0 && data[2] < data[1])
+            counters->values[i] = (uint64_t)((double)data[0] * data[1] / data[2]);
+        else
+            counters->values[i] = data[0];
+    }
+}
+
+// Leaves available and values alone, they're reported after closing
+void perf_counters_close(struct perf_counters *counters) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counters->fds[i] >= 0)
+            close(counters->fds[i]);
+        counters->fds[i] = -1;
+    }
+}
+#else
+bool perf_counters_open(struct perf_counters *counters) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        counters->available[i] = false;
+        counters->values[i] = 0;
+    }
+    fprintf(stderr, "Hardware counters need perf_event_open (Linux)\n");
+    return false;
+}
+
+void perf_counters_start(struct perf_counters *counters) {}
+void perf_counters_stop(struct perf_counters *counters) {}
+void perf_counters_close(struct perf_counters *counters) {}
+#endif
+
+#endif
@@ -0,0 +1,209 @@
+#include "ppu.h"
+
+uint8_t gb_obj_line_buffer[176];
+uint8_t gb_win_line_buffer[176];
+uint8_t gb_bg_line_buffer[176];
+uint8_t gb_frame_buffer[SCR_HEIGHT][SCR_WIDTH];
+uint8_t gb_mode = 2;
+uint8_t gb_scanlines = 0;
+uint16_t gb_scanline_dot_counter = 0;
+struct object gb_objects[10];
+uint8_t gb_obj_counter = 0;
+bool gb_ppu_skip_composition = false;
+
+uint8_t gb_get_ppu_mode() {
+    return gb_memory[STAT] & 0b11;
+}
+
+void gb_set_ppu_mode(uint8_t mode) {
+    gb_memory[STAT] &= ~0b11;
+    gb_memory[STAT] |= mode;
+}
+
+static uint8_t get_obj_height() {
+    if (gb_memory[LCDC] & 0b100) 
+        return 16;
+    else 
+        return 8;
+}
+
+uint8_t gb_lcd_enable() {
+    return gb_memory[LCDC] & 0x80;
+}
+
+void gb_ppu_execute(uint8_t dots) {
+    while (dots > 0) {
+        // OAM scan
+        if (gb_get_ppu_mode() == 2) {
+            while (dots > 0) {
+                if (gb_scanline_dot_counter >= 80) {
+                    gb_set_ppu_mode(3);
+                    break;
+                }
+
+                if (gb_ppu_skip_composition) {
+                    gb_scanline_dot_counter += 4;
+                    dots -= 4;
+                    continue;
+                }
+
+                if (gb_memory[LCDC] & 0x1 && gb_scanline_dot_counter % 4 == 0) { // if BG & window enable
+                    uint16_t tile_map_start;
+                    if (gb_memory[LCDC] & 0x8) // Check BG tile map area
+                        tile_map_start = 0x9C00;
+                    else
+                        tile_map_start = 0x8800;
+                    
+                    uint8_t tile_x = ((gb_memory[SCX] + 2*gb_scanline_dot_counter) % 256) / 8;
+                    uint8_t tile_y = (((gb_memory[SCY] + gb_memory[LY]) % 256 ) / 8 );
+                    
+                    uint16_t tile_index = tile_map_start + tile_x + 32*tile_y;
+                    uint8_t tile = gb_memory[tile_index];
+                    
+                    uint16_t base_pointer;
+                    if (gb_memory[LCDC] & 0x10) {
+                        base_pointer = 0x8000;
+                        uint8_t pixel = 0;
+                        for (int i = 0; i < 8; i++){
+                            uint16_t pixel_byte_pointer = base_pointer + 16*tile + (gb_memory[LY] + gb_memory[SCY]) % 8;
+                            uint8_t first_byte = gb_memory[pixel_byte_pointer];
+                            uint8_t second_byte = gb_memory[pixel_byte_pointer+1];
+                            pixel |= (first_byte >> (7 - i)) & 0b01;
+                            pixel |= ((second_byte >> (7 - i)) << 1) & 0b10;
+                            gb_bg_line_buffer[gb_scanline_dot_counter+i] = pixel;
+                        }
+                    }
+                }
+
+                if (gb_obj_counter < 10 && ((gb_memory[0xFE00 + gb_scanline_dot_counter*4] - 16) <= gb_memory[LY]) 
+                    && (gb_memory[0xFE00 + gb_scanline_dot_counter*4] - 16 + get_obj_height()) >= gb_memory[LY]) { // Checks if obj is on line
+                    gb_objects[gb_obj_counter].y_pos = gb_memory[0xFE00 + gb_scanline_dot_counter*4] - 16;
+                    gb_objects[gb_obj_counter].x_pos = gb_memory[0xFE00 + gb_scanline_dot_counter*4 + 1];
+                    gb_objects[gb_obj_counter].tile_index = gb_memory[0xFE00 + gb_scanline_dot_counter*4 + 2];
+                    gb_objects[gb_obj_counter].attributes = gb_memory[0xFE00 + gb_scanline_dot_counter*4 + 3];
+
+                    struct object obj = gb_objects[gb_obj_counter];
+                    uint8_t first_byte, second_byte;
+                    uint8_t pixel;
+                    uint8_t current_y = gb_memory[LY];
+                    if (obj.attributes & 0x40) {                        
+                        first_byte = gb_memory[0x8000 + (obj.tile_index+1)*16 - (current_y - obj.y_pos)*2 - 2];
+                        second_byte = gb_memory[0x8000 + (obj.tile_index+1)*16 - (current_y - obj.y_pos)*2 - 1];
+                    }
+                    else {
+                        first_byte = gb_memory[0x8000 + obj.tile_index*16 + (current_y - obj.y_pos)*2];
+                        second_byte = gb_memory[0x8000 + obj.tile_index*16 + (current_y - obj.y_pos)*2 + 1];
+                    }
+
+                    for (int i = 0; i < 8; i++) {
+                        pixel = 0;
+
+                        if (obj.attributes & 0x20) {
+                            pixel |= (first_byte >> i) & 0b01;
+                            pixel |= ((second_byte >> i) << 1) & 0b10;
+                        }
+                        else {
+                            pixel |= (first_byte >> (7 - i)) & 0b01;
+                            pixel |= ((second_byte >> (7 - i)) << 1) & 0b10;
+                        }
+                        // uint8_t color_pallette;
+                        // if (obj.attributes & 0x10)
+                        //     color_pallette = gb_memory[OBP1];
+                        // else 
+                        //     color_pallette = gb_memory[OBP0];
+
+                        // if (pixel == 0b11)
+                        //     pixel = gb_memory[OBP1] >> 6;
+                        // else if (pixel == 0b10)
+                        //     pixel = (gb_memory[OBP1] >> 4) & 0b11;
+                        // else if (pixel == 0b01)
+                        //     pixel = (gb_memory[OBP1] >> 2) & 0b11;
+
+                        if (obj.x_pos + i < 176)
+                            gb_obj_line_buffer[obj.x_pos + i] = pixel;
+                    }
+                    gb_obj_counter++;
+                }
+                gb_scanline_dot_counter += 4;        
+                dots -= 4;
+            }
+        }
+
+        // Drawing pixels (to gb_frame_buffer)
+        if (gb_get_ppu_mode() == 3 && gb_ppu_skip_composition) {
+            int skipped = 240 - gb_scanline_dot_counter;
+            if (skipped > dots)
+                skipped = dots;
+            if (skipped > 0) {
+                gb_scanline_dot_counter += skipped;
+                dots -= skipped;
+            }
+            if (dots > 0) {
+                gb_obj_counter = 0;
+                gb_set_ppu_mode(0);
+            }
+        }
+        if (gb_get_ppu_mode() == 3) {
+            while (dots > 0) {
+                if (gb_scanline_dot_counter >= 240) {
+                    gb_obj_counter = 0;
+                    gb_set_ppu_mode(0);
+                    break;
+                } 
+                int current_x = gb_scanline_dot_counter - 80;
+                int current_y = gb_memory[LY];
+
+                if (gb_obj_line_buffer[current_x+8])
+                    gb_frame_buffer[current_y][current_x] = gb_obj_line_buffer[current_x+8];
+                else
+                    gb_frame_buffer[current_y][current_x] = gb_bg_line_buffer[current_x];
+                gb_scanline_dot_counter += 1;
+        
+                dots--;
+            }
+        }
+
+        // Horizontal blank
+        if (gb_get_ppu_mode() == 0) {
+            while (dots > 0) {
+                if (gb_scanline_dot_counter >= 456) {
+                    gb_scanline_dot_counter = 0;
+                    gb_memory[LY]++;
+                    dots--;
+                    for (int i = 0; i < 176; i++) {
+                        gb_obj_line_buffer[i] = 0;
+                    }
+                    if (gb_memory[LY] > 143) {
+                        gb_set_ppu_mode(1);
+                        gb_memory[IF] |= 1;
+                        break;
+                    }
+                    else {
+                        gb_set_ppu_mode(2);
+                        break;
+                    }
+                }
+                gb_scanline_dot_counter++;
+                dots--;
+            }
+        }
+
+        // Vertical blank
+        if (gb_get_ppu_mode() == 1) {
+            while (dots > 0) {
+                if (gb_scanline_dot_counter >= 456) {
+                    gb_scanline_dot_counter = 0;
+                    gb_memory[LY]++;
+                    if (gb_memory[LY] > 153) {
+                        gb_memory[LY] = 0;
+                        gb_set_ppu_mode(2);
+                        dots--;
+                        break;
+                    }
+                }
+                gb_scanline_dot_counter++;
+                dots--;
+            }
+        }
+    }
+}
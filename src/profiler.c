@@ -0,0 +1,144 @@
+#include "profiler.h"
+
+#ifdef PROFILE_OPCODES
+
+enum opcode_class {
+    CLASS_LOAD,
+    CLASS_ARITH8,
+    CLASS_ARITH16,
+    CLASS_LOGIC,
+    CLASS_BIT_FLAG,
+    CLASS_BIT_SHIFT,
+    CLASS_JUMP,
+    CLASS_CARRY_FLAG,
+    CLASS_STACK,
+    CLASS_INTERRUPT,
+    CLASS_MISC,
+    NUM_OPCODE_CLASSES
+};
+
+static const char *opcode_class_names[NUM_OPCODE_CLASSES] = {
+    "load", "8-bit arithmetic", "16-bit arithmetic", "bitwise logic", "bit flag",
+    "bit shift", "jump/call", "carry flag", "stack", "interrupt", "misc"
+};
+
+// Index 0x000-0x0FF is the base table, 0x100-0x1FF the CB table
+static uint64_t opcode_counts[0x200];
+static uint64_t opcode_ns[0x200];
+static uint64_t opcode_M_cycles[0x200];
+static uint64_t profile_timer_overhead_ns = 0;
+uint64_t gb_profile_start_ns;
+
+static int profile_index(uint16_t opcode) {
+    return (opcode >> 8) == 0xCB ? 0x100 | (opcode & 0xFF) : opcode & 0xFF;
+}
+
+// Grouped like the cases in gb_cpu_execute
+static enum opcode_class get_opcode_class(uint16_t opcode) {
+    if ((opcode >> 8) == 0xCB)
+        return (opcode & 0xFF) >= 0x40 ? CLASS_BIT_FLAG : CLASS_BIT_SHIFT;
+
+    uint8_t op = opcode & 0xFF;
+    uint8_t low = op & 0x0F;
+    if (op == 0x76 || op == 0xF3 || op == 0xFB)
+        return CLASS_INTERRUPT;
+    if (op >= 0x40 && op <= 0x7F)
+        return CLASS_LOAD;
+    if (op >= 0x80 && op <= 0x9F)
+        return CLASS_ARITH8;
+    if ((op >= 0xA0 && op <= 0xB7) || op == 0x2F || op == 0xE6 || op == 0xEE || op == 0xF6)
+        return CLASS_LOGIC;
+    if ((op >= 0xB8 && op <= 0xBF) || op == 0xFE || op == 0xC6 || op == 0xCE || op == 0xD6 || op == 0xDE)
+        return CLASS_ARITH8;
+    if (op < 0x40 && (low == 0x04 || low == 0x05 || low == 0x0C || low == 0x0D))
+        return CLASS_ARITH8;
+    if (op < 0x40 && (low == 0x03 || low == 0x09 || low == 0x0B))
+        return CLASS_ARITH16;
+    if (op == 0x07 || op == 0x0F || op == 0x17 || op == 0x1F)
+        return CLASS_BIT_SHIFT;
+    if (op == 0x37 || op == 0x3F)
+        return CLASS_CARRY_FLAG;
+    if (op == 0x18 || op == 0x20 || op == 0x28 || op == 0x30 || op == 0x38)
+        return CLASS_JUMP;
+    if (op == 0x08 || op == 0xF8 || op == 0xF9)
+        return CLASS_LOAD;
+    if ((op >= 0xC0 && (low == 0x01 || low == 0x05)) || op == 0xE8)
+        return CLASS_STACK;
+    if (op >= 0xC0 && (low == 0x00 || low == 0x02 || low == 0x03 || low == 0x04 || low == 0x07
+        || low == 0x08 || low == 0x09 || low == 0x0A || low == 0x0C || low == 0x0D || low == 0x0F)
+        && op != 0xE0 && op != 0xF0 && op != 0xE2 && op != 0xF2 && op != 0xEA && op != 0xFA)
+        return CLASS_JUMP;
+    if (op == 0x00 || op == 0x10 || op == 0x27)
+        return CLASS_MISC;
+    return CLASS_LOAD;
+}
+
+void gb_profiler_init() {
+    // Calibrate the cost of a begin/end pair so it can be subtracted
+    uint64_t start = gb_host_time_ns();
+    for (int i = 0; i < 1000; i++)
+        gb_host_time_ns();
+    profile_timer_overhead_ns = (gb_host_time_ns() - start) / 1000;
+}
+
+void gb_profile_opcode(uint16_t opcode, int M_cycles, uint64_t ns) {
+    int index = profile_index(opcode);
+    opcode_counts[index]++;
+    opcode_ns[index] += ns > profile_timer_overhead_ns ? ns - profile_timer_overhead_ns : 0;
+    opcode_M_cycles[index] += M_cycles;
+}
+
+static int compare_opcode_time(const void *a, const void *b) {
+    uint64_t ns_a = opcode_ns[*(const int *)a];
+    uint64_t ns_b = opcode_ns[*(const int *)b];
+    return (ns_a < ns_b) - (ns_a > ns_b);
+}
+
+void gb_profiler_report(FILE *out) {
+    int order[0x200];
+    uint64_t total_count = 0, total_ns = 0;
+    uint64_t class_counts[NUM_OPCODE_CLASSES] = {0};
+    uint64_t class_ns[NUM_OPCODE_CLASSES] = {0};
+    uint64_t class_M_cycles[NUM_OPCODE_CLASSES] = {0};
+
+    for (int i = 0; i < 0x200; i++) {
+        order[i] = i;
+        total_count += opcode_counts[i];
+        total_ns += opcode_ns[i];
+        uint16_t opcode = i >= 0x100 ? 0xCB00 | (i & 0xFF) : i;
+        enum opcode_class class = get_opcode_class(opcode);
+        class_counts[class] += opcode_counts[i];
+        class_ns[class] += opcode_ns[i];
+        class_M_cycles[class] += opcode_M_cycles[i];
+    }
+    qsort(order, 0x200, sizeof(int), compare_opcode_time);
+    if (total_ns == 0)
+        total_ns = 1;
+
+    fprintf(out, "Opcode profile: %llu instructions, %.3f ms host time (timer overhead %llu ns removed)\n",
+        (unsigned long long)total_count, total_ns / 1e6, (unsigned long long)profile_timer_overhead_ns);
+    fprintf(out, "%-8s %14s %12s %8s %7s %14s\n", "opcode", "count", "host ms", "ns/op", "time%", "M-cycles");
+    for (int i = 0; i < 0x200; i++) {
+        int index = order[i];
+        if (opcode_counts[index] == 0)
+            continue;
+        char name[8];
+        if (index >= 0x100)
+            snprintf(name, sizeof(name), "CB %02X", index & 0xFF);
+        else
+            snprintf(name, sizeof(name), "%02X", index);
+        fprintf(out, "%-8s %14llu %12.3f %8.1f %6.2f%% %14llu\n", name,
+            (unsigned long long)opcode_counts[index], opcode_ns[index] / 1e6,
+            (double)opcode_ns[index] / opcode_counts[index], 100.0 * opcode_ns[index] / total_ns,
+            (unsigned long long)opcode_M_cycles[index]);
+    }
+
+    fprintf(out, "\n%-18s %14s %12s %7s %14s\n", "class", "count", "host ms", "time%", "M-cycles");
+    for (int i = 0; i < NUM_OPCODE_CLASSES; i++) {
+        fprintf(out, "%-18s %14llu %12.3f %6.2f%% %14llu\n", opcode_class_names[i],
+            (unsigned long long)class_counts[i], class_ns[i] / 1e6, 100.0 * class_ns[i] / total_ns,
+            (unsigned long long)class_M_cycles[i]);
+    }
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Per-opcode execution profiler. Build with -DPROFILE_OPCODES to enable it,
+// otherwise the hooks compile to nothing.
+
+#ifdef PROFILE_OPCODES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "hosttime.h"
+
+extern uint64_t gb_profile_start_ns;
+
+void gb_profiler_init();
+
+void gb_profile_opcode(uint16_t opcode, int M_cycles, uint64_t ns);
+
+void gb_profiler_report(FILE *out);
+
+#define PROFILE_OPCODE_BEGIN() gb_profile_start_ns = gb_host_time_ns()
+#define PROFILE_OPCODE_END(opcode, M_cycles) gb_profile_opcode(opcode, M_cycles, gb_host_time_ns() - gb_profile_start_ns)
+
+#else
+
+#define gb_profiler_init()
+#define gb_profiler_report(out)
+#define PROFILE_OPCODE_BEGIN()
+#define PROFILE_OPCODE_END(opcode, M_cycles)
+
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hosttime.h"
+#include "emulator.h"
+#include "movie.h"
+#include "state.h"
+#include "workers.h"
+
+// Frame hash regression suite. Every manifest line names a ROM, an input
+// movie (or -), a frame count and the frames whose gb_frame_buffer hash is
+// checked:
+//   ROMS/tetris.gb movies/tetris.gbm 3600 600,1200,3600
+// Golden hashes live next to the manifest in <manifest>.golden as
+// "<rom> <movie> <frame> <hash>" lines, --update rewrites them from this
+// run and keeps the old ones of entries that failed to run. Older
+// "<rom> <frame> <hash>" lines still load and match any movie.
+
+#define MAX_REGRESSION_ENTRIES 1024
+#define MAX_CHECKPOINTS 64
+
+struct regression_entry {
+    char rom[256];
+    char movie[256];
+    int frames;
+    int checkpoint_count;
+    int checkpoints[MAX_CHECKPOINTS];
+};
+
+struct regression_result {
+    char error[64];
+    int frames_run;
+    uint64_t hashes[MAX_CHECKPOINTS];
+    double host_ms;
+};
+
+struct golden_hash {
+    char rom[256];
+    char movie[256]; // Empty for the old format without movies
+    int frame;
+    uint64_t hash;
+};
+
+struct regression_entry entries[MAX_REGRESSION_ENTRIES];
+int entry_count = 0;
+struct golden_hash *golden = NULL;
+int golden_count = 0;
+
+bool load_manifest(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open manifest %s!\n", path);
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), file) && entry_count < MAX_REGRESSION_ENTRIES) {
+        struct regression_entry *entry = &entries[entry_count];
+        char checkpoints[512];
+        if (line[0] == '#' || sscanf(line, "%255s %255s %d %511s", entry->rom, entry->movie, &entry->frames, checkpoints) != 4)
+            continue;
+
+        entry->checkpoint_count = 0;
+        for (char *token = strtok(checkpoints, ","); token && entry->checkpoint_count < MAX_CHECKPOINTS; token = strtok(NULL, ",")) {
+            int frame = atoi(token);
+            if (frame > 0 && frame <= entry->frames)
+                entry->checkpoints[entry->checkpoint_count++] = frame;
+        }
+        entry_count++;
+    }
+    fclose(file);
+    return true;
+}
+
+void load_golden(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return;
+    int capacity = 256;
+    golden = malloc(capacity * sizeof(struct golden_hash));
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        struct golden_hash g;
+        char frame[32], hash[32];
+        int fields = sscanf(line, "%255s %255s %31s %31s", g.rom, g.movie, frame, hash);
+        if (fields == 3) {
+            strcpy(hash, frame);
+            strcpy(frame, g.movie);
+            g.movie[0] = 0;
+        }
+        else if (fields != 4)
+            continue;
+        g.frame = atoi(frame);
+        g.hash = strtoull(hash, NULL, 16);
+        if (golden_count == capacity) {
+            capacity *= 2;
+            golden = realloc(golden, capacity * sizeof(struct golden_hash));
+        }
+        golden[golden_count++] = g;
+    }
+    fclose(file);
+}
+
+bool golden_matches(const struct golden_hash *g, const struct regression_entry *entry) {
+    return strcmp(g->rom, entry->rom) == 0 && (g->movie[0] == 0 || strcmp(g->movie, entry->movie) == 0);
+}
+
+struct golden_hash *find_golden(const struct regression_entry *entry, int frame) {
+    for (int i = 0; i < golden_count; i++) {
+        if (golden[i].frame == frame && golden_matches(&golden[i], entry))
+            return &golden[i];
+    }
+    return NULL;
+}
+
+void run_regression_entry(int index, void *data) {
+    struct regression_entry *entry = &entries[index];
+    struct regression_result *result = data;
+    uint64_t start = gb_host_time_ns();
+
+    if (!gb_init_memory(entry->rom)) {
+        snprintf(result->error, sizeof(result->error), "could not load ROM");
+        return;
+    }
+    gb_init_cpu_registers();
+    if (strcmp(entry->movie, "-") != 0 && !movie_start_playback(entry->movie)) {
+        snprintf(result->error, sizeof(result->error), "could not play movie");
+        return;
+    }
+
+    int next_checkpoint = 0;
+    for (int frame = 1; frame <= entry->frames; frame++) {
+        movie_frame_input();
+        gb_run_frame();
+        result->frames_run = frame;
+        // Checkpoints may be listed in any order
+        for (int i = 0; i < entry->checkpoint_count; i++) {
+            if (entry->checkpoints[i] == frame) {
+                result->hashes[i] = gb_xxh64(gb_frame_buffer, sizeof(gb_frame_buffer), 0);
+                next_checkpoint++;
+            }
+        }
+        if (next_checkpoint == entry->checkpoint_count)
+            break;
+    }
+    result->host_ms = (gb_host_time_ns() - start) / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    char *manifest_path = NULL;
+    bool update = false;
+    int jobs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i+1 < argc)
+            jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--update") == 0)
+            update = true;
+        else
+            manifest_path = argv[i];
+    }
+    if (manifest_path == NULL) {
+        fprintf(stderr, "usage: regression [-j jobs] [--update] manifest.txt\n");
+        return 1;
+    }
+    if (!load_manifest(manifest_path))
+        return 1;
+    if (jobs <= 0)
+        jobs = default_job_count();
+
+    char golden_path[1100];
+    snprintf(golden_path, sizeof(golden_path), "%s.golden", manifest_path);
+    load_golden(golden_path);
+
+    struct regression_result *results = calloc(entry_count, sizeof(struct regression_result));
+    bool *crashed = calloc(entry_count, sizeof(bool));
+    uint64_t start = gb_host_time_ns();
+    run_workers(entry_count, jobs, run_regression_entry, results, sizeof(struct regression_result), crashed);
+    double seconds = (gb_host_time_ns() - start) / 1e9;
+
+    int passed = 0, failed = 0, missing = 0;
+    long long total_frames = 0;
+    for (int i = 0; i < entry_count; i++) {
+        struct regression_entry *entry = &entries[i];
+        struct regression_result *result = &results[i];
+        total_frames += result->frames_run;
+        char name[520];
+        if (strcmp(entry->movie, "-") == 0)
+            snprintf(name, sizeof(name), "%.255s", entry->rom);
+        else
+            snprintf(name, sizeof(name), "%.255s (%.255s)", entry->rom, entry->movie);
+        if (crashed[i] || result->error[0]) {
+            printf("ERROR %s: %s\n", name, crashed[i] ? "worker crashed" : result->error);
+            failed++;
+            continue;
+        }
+
+        int mismatches = 0, unknown = 0;
+        for (int c = 0; c < entry->checkpoint_count; c++) {
+            struct golden_hash *g = find_golden(entry, entry->checkpoints[c]);
+            if (g == NULL) {
+                unknown++;
+            }
+            else if (g->hash != result->hashes[c]) {
+                if (mismatches == 0)
+                    printf("FAIL  %s: frame %d expected %016llx, got %016llx\n", name, entry->checkpoints[c],
+                        (unsigned long long)g->hash, (unsigned long long)result->hashes[c]);
+                mismatches++;
+            }
+        }
+        if (mismatches) {
+            failed++;
+        }
+        else if (unknown) {
+            printf("NEW   %s: %d checkpoints without golden hashes (%.1f ms)\n", name, unknown, result->host_ms);
+            missing++;
+        }
+        else {
+            printf("PASS  %s: %d checkpoints, %d frames in %.1f ms\n", name, entry->checkpoint_count,
+                result->frames_run, result->host_ms);
+            passed++;
+        }
+    }
+    printf("\n%d passed, %d failed, %d without golden hashes, %lld frames in %.2fs with %d jobs\n",
+        passed, failed, missing, total_frames, seconds, jobs);
+
+    if (update) {
+        FILE *file = fopen(golden_path, "w");
+        if (file == NULL) {
+            fprintf(stderr, "Could not write %s!\n", golden_path);
+            return 1;
+        }
+        for (int i = 0; i < entry_count; i++) {
+            struct regression_entry *entry = &entries[i];
+            if (crashed[i] || results[i].error[0]) {
+                // A transient failure mustn't lose the known good hashes
+                for (int g = 0; g < golden_count; g++) {
+                    if (golden_matches(&golden[g], entry))
+                        fprintf(file, "%s %s %d %016llx\n", entry->rom, entry->movie, golden[g].frame, (unsigned long long)golden[g].hash);
+                }
+                continue;
+            }
+            for (int c = 0; c < entry->checkpoint_count; c++)
+                fprintf(file, "%s %s %d %016llx\n", entry->rom, entry->movie, entry->checkpoints[c], (unsigned long long)results[i].hashes[c]);
+        }
+        fclose(file);
+        printf("Wrote %s\n", golden_path);
+        return 0;
+    }
+    return failed || missing ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "serial.h"
+
+uint8_t gb_serial_output[SERIAL_BUFFER_SIZE + 1];
+int gb_serial_output_length = 0;
+bool gb_serial_transfer_active = false;
+int gb_serial_transfer_cycles = 0;
+uint8_t gb_serial_outgoing = 0;
+
+struct link_endpoint *gb_link_endpoint = NULL;
+
+static bool link_push(struct link_ring *ring, struct link_message message) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == LINK_RING_SIZE)
+        return false;
+    ring->messages[tail % LINK_RING_SIZE] = message;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static bool link_peek(struct link_ring *ring, struct link_message *message) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&ring->tail, memory_order_acquire))
+        return false;
+    *message = ring->messages[head % LINK_RING_SIZE];
+    return true;
+}
+
+static void link_pop(struct link_ring *ring) {
+    atomic_fetch_add_explicit(&ring->head, 1, memory_order_release);
+}
+
+static void link_send(uint8_t type, uint8_t byte, uint64_t time) {
+    struct link_message message = {time, type, byte};
+    link_push(&gb_link_endpoint->channel->rings[1 - gb_link_endpoint->side], message);
+}
+
+static bool link_peer_closed() {
+    return atomic_load(&gb_link_endpoint->channel->closed[1 - gb_link_endpoint->side]);
+}
+
+void gb_write_serial_control(uint8_t value) {
+    gb_memory[SC] = value | 0x7E;
+    // Only the internal clock drives a transfer, an external one waits for a partner
+    if ((value & 0x81) == 0x81) {
+        gb_serial_transfer_active = true;
+        gb_serial_transfer_cycles = 8 * SERIAL_BIT_M_CYCLES;
+        gb_serial_outgoing = gb_memory[SB];
+        if (gb_link_endpoint) {
+            gb_link_endpoint->reply_ready = false;
+            link_send(LINK_TRANSFER, gb_serial_outgoing, gb_link_endpoint->time + LINK_BYTE_M_CYCLES);
+        }
+    }
+    else if (!(value & 0x80)) {
+        gb_serial_transfer_active = false;
+    }
+}
+
+static void finish_serial_transfer(uint8_t incoming) {
+    if (gb_serial_output_length < SERIAL_BUFFER_SIZE) {
+        gb_serial_output[gb_serial_output_length++] = gb_serial_outgoing;
+        gb_serial_output[gb_serial_output_length] = 0;
+    }
+    gb_memory[SB] = incoming;
+    gb_memory[SC] &= ~0x80;
+    gb_memory[IF] |= 0x08;
+    gb_serial_transfer_active = false;
+}
+
+void gb_serial_tick(int M_cycles) {
+    if (gb_link_endpoint && gb_link_endpoint->awaiting_reply)
+        return;
+    gb_serial_transfer_cycles -= M_cycles;
+    if (gb_serial_transfer_cycles > 0)
+        return;
+    if (gb_link_endpoint && !link_peer_closed()) {
+        if (gb_link_endpoint->reply_ready)
+            finish_serial_transfer(gb_link_endpoint->reply);
+        else
+            gb_link_endpoint->awaiting_reply = true;
+    }
+    else
+        finish_serial_transfer(0xFF);
+}
+
+// The other side's transfer reached its end here
+static void answer_link_transfer(uint8_t incoming) {
+    // External clock with a transfer requested shifts, anything else doesn't
+    if ((gb_memory[SC] & 0x81) == 0x80) {
+        gb_serial_outgoing = gb_memory[SB];
+        link_send(LINK_REPLY, gb_serial_outgoing, gb_link_endpoint->time);
+        finish_serial_transfer(incoming);
+    }
+    else
+        link_send(LINK_REPLY, 0xFF, gb_link_endpoint->time);
+}
+
+void gb_link_receive() {
+    struct link_ring *ring = &gb_link_endpoint->channel->rings[gb_link_endpoint->side];
+    struct link_message message;
+    while (link_peek(ring, &message)) {
+        if (message.type == LINK_TRANSFER) {
+            gb_link_endpoint->transfer_pending = true;
+            gb_link_endpoint->pending_transfer = message;
+        }
+        else if (gb_link_endpoint->awaiting_reply) {
+            gb_link_endpoint->awaiting_reply = false;
+            gb_link_endpoint->transfers++;
+            finish_serial_transfer(message.byte);
+        }
+        else {
+            gb_link_endpoint->reply_ready = true;
+            gb_link_endpoint->reply = message.byte;
+            gb_link_endpoint->transfers++;
+        }
+        link_pop(ring);
+    }
+    if (gb_link_endpoint->transfer_pending && gb_link_endpoint->pending_transfer.time <= gb_link_endpoint->time) {
+        // A side that ran ahead in relaxed mode may not have requested the
+        // next transfer yet where this one was due, it gets up to a frame
+        uint64_t due = gb_link_endpoint->pending_transfer.time;
+        if (gb_link_endpoint->relaxed && !(gb_memory[SC] & 0x80) && gb_link_endpoint->time <= due + LINK_RELAXED_LOOKAHEAD)
+            return;
+        gb_link_endpoint->transfer_pending = false;
+        answer_link_transfer(gb_link_endpoint->pending_transfer.byte);
+    }
+}
+
+void gb_link_tick(int M_cycles) {
+    gb_link_endpoint->time += M_cycles;
+    atomic_store_explicit(&gb_link_endpoint->channel->time[gb_link_endpoint->side], gb_link_endpoint->time, memory_order_release);
+}
+
+bool gb_link_can_run() {
+    gb_link_receive();
+    if (link_peer_closed()) {
+        if (gb_link_endpoint->awaiting_reply) {
+            gb_link_endpoint->awaiting_reply = false;
+            finish_serial_transfer(0xFF);
+        }
+        return true;
+    }
+    if (gb_link_endpoint->awaiting_reply)
+        return false;
+    // Only a side that will answer a late transfer with its SB may run
+    // ahead: one with a transfer requested, or one holding a transfer
+    bool relaxed = gb_link_endpoint->relaxed && ((gb_memory[SC] & 0x80) || gb_link_endpoint->transfer_pending);
+    uint64_t peer_time = atomic_load_explicit(&gb_link_endpoint->channel->time[1 - gb_link_endpoint->side], memory_order_acquire);
+    return gb_link_endpoint->time <= peer_time + (relaxed ? LINK_RELAXED_LOOKAHEAD : LINK_STRICT_LOOKAHEAD);
+}
@@ -0,0 +1,102 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "gbmemory.h"
+
+// Serial port (SB/SC). With no link partner every transfer shifts in 0xFF.
+// Outgoing bytes are captured so test ROMs that print through the serial
+// port (blargg) can be read back.
+//
+// A link cable connects two instances through a link_channel: one ring of
+// messages towards each side, and each side's clock in M-cycles. A side
+// starting an internal-clock transfer sends its byte stamped with the time
+// the transfer ends. The other side handles it once its own clock reaches
+// that time: with an external-clock transfer pending it answers with its
+// SB and takes the byte, otherwise it answers 0xFF. The sender waits at
+// the end of its transfer for the answer. In strict mode neither side runs
+// more than a byte's transfer time ahead of the other, so every message
+// arrives before it is due and linked runs are deterministic. Relaxed mode
+// lets a side run up to a frame ahead while its SC has a transfer
+// requested, which is when games wait on the link. A transfer that arrives
+// after it was due is answered once the receiver requests one, which it
+// may not have done yet at its later clock, or with 0xFF if it hasn't
+// within a frame, so no byte is lost because its receiver ran ahead.
+// Stepping never blocks here, gb_link_can_run says when a side has to wait.
+
+#define SERIAL_BUFFER_SIZE 4096
+#define SERIAL_BIT_M_CYCLES 128 // 8192 Hz internal clock
+
+extern uint8_t gb_serial_output[SERIAL_BUFFER_SIZE + 1];
+extern int gb_serial_output_length;
+extern bool gb_serial_transfer_active;
+extern int gb_serial_transfer_cycles;
+extern uint8_t gb_serial_outgoing;
+
+#define LINK_RING_SIZE 16
+#define LINK_BYTE_M_CYCLES (8 * SERIAL_BIT_M_CYCLES)
+#define LINK_STRICT_LOOKAHEAD (LINK_BYTE_M_CYCLES - 32) // Margin for the instruction crossing the limit
+#define LINK_RELAXED_LOOKAHEAD 17556 // One frame
+
+enum link_message_type {
+    LINK_TRANSFER,
+    LINK_REPLY
+};
+
+struct link_message {
+    uint64_t time;
+    uint8_t type;
+    uint8_t byte;
+};
+
+// Single producer, single consumer
+struct link_ring {
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    struct link_message messages[LINK_RING_SIZE];
+};
+
+#define LINK_CHANNEL_READY 0x4B4E494C // "LINK"
+
+// Shared by both sides, either in one process or in shared memory
+struct link_channel {
+    _Atomic uint64_t time[2];
+    _Atomic uint32_t closed[2];
+    _Atomic uint32_t ready;    // LINK_CHANNEL_READY once side 0 set up shared memory
+    _Atomic int32_t pids[2];   // Process of each side in shared memory
+    struct link_ring rings[2]; // rings[i] holds the messages to side i
+};
+
+struct link_endpoint {
+    struct link_channel *channel;
+    int side;
+    bool relaxed;
+    uint64_t time;
+    bool awaiting_reply;    // Own transfer finished, the answer hasn't come yet
+    bool reply_ready;       // Answer came before the own transfer finished
+    uint8_t reply;
+    bool transfer_pending;  // The other side's transfer, not due yet
+    struct link_message pending_transfer;
+    uint64_t transfers;
+};
+
+extern struct link_endpoint *gb_link_endpoint;
+
+void gb_write_serial_control(uint8_t value);
+
+void gb_serial_tick(int M_cycles);
+
+// Handles the messages that are due. A transfer that isn't is held aside
+// so answers queued behind it still get through.
+void gb_link_receive();
+
+// Called after every instruction with its M-cycles
+void gb_link_tick(int M_cycles);
+
+// Handles due messages and returns whether this side may run its next
+// instruction, false while it waits for an answer or is too far ahead
+bool gb_link_can_run();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,242 @@
+#ifndef SHMCHANNEL_H
+#define SHMCHANNEL_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gbmemory.h"
+#include "ppu.h"
+#include "input.h"
+#include "emulator.h"
+
+// Observation and control channel for agents in another process, through a
+// POSIX shared-memory segment. The agent fills in buttons and frames, then
+// increments command and wakes it. The emulator applies the buttons, runs
+// that many frames, copies out the observation and sets done to command.
+// Both counters are futex words on Linux, elsewhere they are polled.
+
+#define SHM_CHANNEL_MAGIC 0x4D485347 // "GSHM"
+#define SHM_CHANNEL_VERSION 2
+#define SHM_ATTACH_TIMEOUT_MS 1000
+
+struct shm_control {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              // Whole segment
+    _Atomic uint32_t command;   // Incremented by the agent for each request
+    _Atomic uint32_t done;      // Set to command once the request has run
+    uint32_t frames;            // Frames to run, 0 only refreshes the observation
+    uint32_t buttons;           // Held buttons as BUTTON_* bits
+    uint32_t quit;              // Set with a command to stop the emulator
+    int32_t pid;                // Emulator that created the segment
+    uint64_t frame_count;       // Frames run since startup
+    uint64_t instruction_count;
+};
+
+struct shm_segment {
+    struct shm_control control;
+    uint8_t frame_buffer[SCR_HEIGHT][SCR_WIDTH]; // Color indices 0-3
+    uint8_t wram[0x2000];       // 0xC000-0xDFFF
+    uint8_t hram[0x80];         // 0xFF80-0xFFFF, IE included
+};
+
+enum shm_status {
+    SHM_RUN,
+    SHM_IDLE,
+    SHM_QUIT
+};
+
+struct shm_segment *shm_segment = NULL;
+char shm_name[256];
+uint32_t shm_command_seen = 0;
+uint32_t shm_frames_left = 0;
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__unix__)
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// Not FUTEX_PRIVATE_FLAG, the waiter and waker are in different processes
+void futex_wait(_Atomic uint32_t *word, uint32_t value, int timeout_ms) {
+    struct timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, word, FUTEX_WAIT, value, &timeout, NULL, 0);
+}
+
+void futex_wake(_Atomic uint32_t *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+#else
+void futex_wait(_Atomic uint32_t *word, uint32_t value, int timeout_ms) {
+    for (int i = 0; i < timeout_ms * 10 && atomic_load(word) == value; i++)
+        usleep(100);
+}
+
+void futex_wake(_Atomic uint32_t *word) {
+}
+#endif
+
+// Whether the existing segment in fd belongs to an emulator that is still
+// running. One that is being set up gets SHM_ATTACH_TIMEOUT_MS to finish.
+bool shm_segment_in_use(int fd) {
+    struct stat status;
+    for (int waited = 0; fstat(fd, &status) == 0 && status.st_size < (off_t)sizeof(struct shm_control); waited++) {
+        if (waited == SHM_ATTACH_TIMEOUT_MS)
+            return false;
+        usleep(1000);
+    }
+    if (status.st_size < (off_t)sizeof(struct shm_control))
+        return false;
+    struct shm_control *control = mmap(NULL, sizeof(struct shm_control), PROT_READ, MAP_SHARED, fd, 0);
+    if (control == MAP_FAILED)
+        return true; // Can't tell, leave it alone
+    for (int waited = 0; atomic_load((_Atomic uint32_t *)&control->magic) != SHM_CHANNEL_MAGIC; waited++) {
+        if (waited == SHM_ATTACH_TIMEOUT_MS) {
+            munmap(control, sizeof(struct shm_control));
+            return false;
+        }
+        usleep(1000);
+    }
+    pid_t owner = control->pid;
+    munmap(control, sizeof(struct shm_control));
+    return !(kill(owner, 0) != 0 && errno == ESRCH);
+}
+
+// Removes the name if it still is the segment open in fd
+bool shm_unlink_segment(int fd) {
+    struct stat own, current;
+    int current_fd = shm_open(shm_name, O_RDONLY, 0600);
+    if (current_fd < 0)
+        return false;
+    bool same = fstat(fd, &own) == 0 && fstat(current_fd, &current) == 0
+        && own.st_dev == current.st_dev && own.st_ino == current.st_ino;
+    close(current_fd);
+    return same && shm_unlink(shm_name) == 0;
+}
+
+// Creates the segment, name gets a leading slash if it doesn't have one.
+// Refuses a segment another running emulator created, one left behind by
+// a crashed emulator is removed and created again.
+bool shm_channel_open(const char *name) {
+    snprintf(shm_name, sizeof(shm_name), "%s%s", name[0] == '/' ? "" : "/", name);
+    int fd = -1;
+    for (int attempt = 0; attempt < 3 && fd < 0; attempt++) {
+        fd = shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd >= 0 || errno != EEXIST)
+            break;
+        int existing = shm_open(shm_name, O_RDONLY, 0600);
+        if (existing < 0)
+            continue; // Removed in between, create it
+        if (shm_segment_in_use(existing)) {
+            fprintf(stderr, "Shared memory %s is in use by another emulator\n", shm_name);
+            close(existing);
+            return false;
+        }
+        if (shm_unlink_segment(existing))
+            fprintf(stderr, "Removed stale shared memory %s\n", shm_name);
+        close(existing);
+    }
+    if (fd < 0 || ftruncate(fd, sizeof(struct shm_segment)) != 0) {
+        fprintf(stderr, "Could not create shared memory %s\n", shm_name);
+        if (fd >= 0) {
+            shm_unlink(shm_name);
+            close(fd);
+        }
+        return false;
+    }
+    shm_segment = mmap(NULL, sizeof(struct shm_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm_segment == MAP_FAILED) {
+        shm_segment = NULL;
+        shm_unlink(shm_name);
+        return false;
+    }
+
+    // A new segment is all zero, the magic goes in last
+    shm_segment->control.version = SHM_CHANNEL_VERSION;
+    shm_segment->control.size = sizeof(struct shm_segment);
+    shm_segment->control.pid = getpid();
+    atomic_store((_Atomic uint32_t *)&shm_segment->control.magic, SHM_CHANNEL_MAGIC);
+    return true;
+}
+
+void shm_channel_close() {
+    if (shm_segment == NULL)
+        return;
+    munmap(shm_segment, sizeof(struct shm_segment));
+    shm_unlink(shm_name);
+    shm_segment = NULL;
+}
+#else
+bool shm_channel_open(const char *name) {
+    fprintf(stderr, "Shared memory channel isn't supported on this platform\n");
+    return false;
+}
+
+void shm_channel_close() {
+}
+
+void futex_wait(_Atomic uint32_t *word, uint32_t value, int timeout_ms) {
+}
+
+void futex_wake(_Atomic uint32_t *word) {
+}
+#endif
+
+void shm_channel_publish() {
+    struct shm_control *control = &shm_segment->control;
+    memcpy(shm_segment->frame_buffer, gb_frame_buffer, sizeof(shm_segment->frame_buffer));
+    memcpy(shm_segment->wram, &gb_memory[0xC000], sizeof(shm_segment->wram));
+    memcpy(shm_segment->hram, &gb_memory[0xFF80], sizeof(shm_segment->hram));
+    control->instruction_count = gb_instruction_counter;
+    atomic_store(&control->done, shm_command_seen);
+    futex_wake(&control->done);
+}
+
+// Call before each frame. Waits up to timeout_ms for a request when the
+// last one has finished, SHM_IDLE means there is no frame to run yet.
+enum shm_status shm_channel_begin_frame(int timeout_ms) {
+    struct shm_control *control = &shm_segment->control;
+    if (shm_frames_left > 0)
+        return SHM_RUN;
+
+    uint32_t command = atomic_load(&control->command);
+    if (command == shm_command_seen) {
+        futex_wait(&control->command, command, timeout_ms);
+        command = atomic_load(&control->command);
+        if (command == shm_command_seen)
+            return SHM_IDLE;
+    }
+    shm_command_seen = command;
+    if (control->quit) {
+        shm_channel_publish();
+        return SHM_QUIT;
+    }
+
+    gb_set_joypad_buttons(control->buttons);
+    shm_frames_left = control->frames;
+    if (shm_frames_left == 0) {
+        shm_channel_publish();
+        return SHM_IDLE;
+    }
+    return SHM_RUN;
+}
+
+// Call after each frame, finishes the request after its last frame
+void shm_channel_end_frame() {
+    shm_segment->control.frame_count++;
+    if (--shm_frames_left == 0)
+        shm_channel_publish();
+}
+
+#endif
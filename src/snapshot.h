@@ -0,0 +1,171 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "emulator.h"
+#include "input.h"
+#include "watch.h"
+
+// Copy-on-write snapshots for tree search. Memory and the frame buffer are
+// split into reference counted pages. gb_clone shares every page with the
+// parent, and saving the running emulator into a snapshot only copies the
+// pages that differ from what it already holds, so a child that ran a few
+// hundred frames from its parent owns a handful of pages.
+
+#define SNAPSHOT_PAGE_SIZE 256
+#define SNAPSHOT_MEMORY_PAGES (0x10000 / SNAPSHOT_PAGE_SIZE)
+#define SNAPSHOT_FRAME_PAGES ((SCR_WIDTH * SCR_HEIGHT + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE)
+#define SNAPSHOT_PAGES (SNAPSHOT_MEMORY_PAGES + SNAPSHOT_FRAME_PAGES)
+
+struct snapshot_page {
+    int references;
+    uint8_t data[SNAPSHOT_PAGE_SIZE];
+};
+
+// Same fields as struct gb_state besides memory and frame_buffer, keep them
+// in sync
+struct gb_snapshot {
+    struct snapshot_page *pages[SNAPSHOT_PAGES];
+
+    struct cpu cpu;
+    int IME_flag;
+    int IME_flag_next;
+
+    uint8_t obj_line_buffer[176];
+    uint8_t win_line_buffer[176];
+    uint8_t bg_line_buffer[176];
+    uint8_t mode;
+    uint8_t scanlines;
+    uint16_t scanline_dot_counter;
+    struct object objects[10];
+    uint8_t obj_counter;
+
+    uint8_t joypad_buttons;
+    int frame_dot_counter;
+
+    bool serial_transfer_active;
+    int serial_transfer_cycles;
+    uint8_t serial_outgoing;
+};
+
+// Where page i lives in the emulator and how many of its bytes are used
+uint8_t *page_source(int i, int *size) {
+    if (i < SNAPSHOT_MEMORY_PAGES) {
+        *size = SNAPSHOT_PAGE_SIZE;
+        return &gb_memory[i * SNAPSHOT_PAGE_SIZE];
+    }
+    int offset = (i - SNAPSHOT_MEMORY_PAGES) * SNAPSHOT_PAGE_SIZE;
+    int remaining = sizeof(gb_frame_buffer) - offset;
+    *size = remaining < SNAPSHOT_PAGE_SIZE ? remaining : SNAPSHOT_PAGE_SIZE;
+    return (uint8_t *)gb_frame_buffer + offset;
+}
+
+void release_page(struct snapshot_page *page) {
+    if (page && --page->references == 0)
+        free(page);
+}
+
+// Saves the running emulator into the snapshot. Pages whose contents didn't
+// change are kept, changed pages are overwritten if this snapshot is their
+// only user and copied otherwise.
+void gb_snapshot_save(struct gb_snapshot *snapshot) {
+    for (int i = 0; i < SNAPSHOT_PAGES; i++) {
+        int size;
+        uint8_t *source = page_source(i, &size);
+        struct snapshot_page *page = snapshot->pages[i];
+        if (page && memcmp(page->data, source, size) == 0)
+            continue;
+        if (page == NULL || page->references > 1) {
+            release_page(page);
+            page = malloc(sizeof(struct snapshot_page));
+            page->references = 1;
+            snapshot->pages[i] = page;
+        }
+        memcpy(page->data, source, size);
+    }
+
+    snapshot->cpu = gb_cpu;
+    snapshot->IME_flag = gb_IME_flag;
+    snapshot->IME_flag_next = gb_IME_flag_next;
+
+    memcpy(snapshot->obj_line_buffer, gb_obj_line_buffer, sizeof(gb_obj_line_buffer));
+    memcpy(snapshot->win_line_buffer, gb_win_line_buffer, sizeof(gb_win_line_buffer));
+    memcpy(snapshot->bg_line_buffer, gb_bg_line_buffer, sizeof(gb_bg_line_buffer));
+    snapshot->mode = gb_mode;
+    snapshot->scanlines = gb_scanlines;
+    snapshot->scanline_dot_counter = gb_scanline_dot_counter;
+    memcpy(snapshot->objects, gb_objects, sizeof(gb_objects));
+    snapshot->obj_counter = gb_obj_counter;
+
+    snapshot->joypad_buttons = gb_joypad_buttons;
+    snapshot->frame_dot_counter = gb_frame_dot_counter;
+
+    snapshot->serial_transfer_active = gb_serial_transfer_active;
+    snapshot->serial_transfer_cycles = gb_serial_transfer_cycles;
+    snapshot->serial_outgoing = gb_serial_outgoing;
+}
+
+void gb_snapshot_load(const struct gb_snapshot *snapshot) {
+    for (int i = 0; i < SNAPSHOT_PAGES; i++) {
+        int size;
+        uint8_t *destination = page_source(i, &size);
+        memcpy(destination, snapshot->pages[i]->data, size);
+    }
+
+    gb_cpu = snapshot->cpu;
+    gb_IME_flag = snapshot->IME_flag;
+    gb_IME_flag_next = snapshot->IME_flag_next;
+
+    memcpy(gb_obj_line_buffer, snapshot->obj_line_buffer, sizeof(gb_obj_line_buffer));
+    memcpy(gb_win_line_buffer, snapshot->win_line_buffer, sizeof(gb_win_line_buffer));
+    memcpy(gb_bg_line_buffer, snapshot->bg_line_buffer, sizeof(gb_bg_line_buffer));
+    gb_mode = snapshot->mode;
+    gb_scanlines = snapshot->scanlines;
+    gb_scanline_dot_counter = snapshot->scanline_dot_counter;
+    memcpy(gb_objects, snapshot->objects, sizeof(gb_objects));
+    gb_obj_counter = snapshot->obj_counter;
+
+    gb_joypad_buttons = snapshot->joypad_buttons;
+    gb_frame_dot_counter = snapshot->frame_dot_counter;
+
+    gb_serial_transfer_active = snapshot->serial_transfer_active;
+    gb_serial_transfer_cycles = snapshot->serial_transfer_cycles;
+    gb_serial_outgoing = snapshot->serial_outgoing;
+    gb_watch_clear_events();
+}
+
+// New snapshot of the running emulator, sharing nothing
+struct gb_snapshot *gb_snapshot_create() {
+    struct gb_snapshot *snapshot = calloc(1, sizeof(struct gb_snapshot));
+    gb_snapshot_save(snapshot);
+    return snapshot;
+}
+
+// Child snapshot sharing all of the parent's pages until one of them saves
+// different contents into it
+struct gb_snapshot *gb_clone(const struct gb_snapshot *parent) {
+    struct gb_snapshot *child = malloc(sizeof(struct gb_snapshot));
+    *child = *parent;
+    for (int i = 0; i < SNAPSHOT_PAGES; i++)
+        child->pages[i]->references++;
+    return child;
+}
+
+void gb_snapshot_free(struct gb_snapshot *snapshot) {
+    for (int i = 0; i < SNAPSHOT_PAGES; i++)
+        release_page(snapshot->pages[i]);
+    free(snapshot);
+}
+
+// Bytes only this snapshot holds, what freeing it would give back
+size_t gb_snapshot_private_bytes(const struct gb_snapshot *snapshot) {
+    size_t bytes = sizeof(struct gb_snapshot);
+    for (int i = 0; i < SNAPSHOT_PAGES; i++) {
+        if (snapshot->pages[i]->references == 1)
+            bytes += sizeof(struct snapshot_page);
+    }
+    return bytes;
+}
+
+#endif
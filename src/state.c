@@ -0,0 +1,62 @@
+#include "state.h"
+
+void gb_save_state(struct gb_state *state) {
+    memcpy(state->memory, gb_memory, sizeof(gb_memory));
+    state->cpu = gb_cpu;
+    state->IME_flag = gb_IME_flag;
+    state->IME_flag_next = gb_IME_flag_next;
+
+    memcpy(state->obj_line_buffer, gb_obj_line_buffer, sizeof(gb_obj_line_buffer));
+    memcpy(state->win_line_buffer, gb_win_line_buffer, sizeof(gb_win_line_buffer));
+    memcpy(state->bg_line_buffer, gb_bg_line_buffer, sizeof(gb_bg_line_buffer));
+    memcpy(state->frame_buffer, gb_frame_buffer, sizeof(gb_frame_buffer));
+    state->mode = gb_mode;
+    state->scanlines = gb_scanlines;
+    state->scanline_dot_counter = gb_scanline_dot_counter;
+    memcpy(state->objects, gb_objects, sizeof(gb_objects));
+    state->obj_counter = gb_obj_counter;
+
+    state->joypad_buttons = gb_joypad_buttons;
+    state->frame_dot_counter = gb_frame_dot_counter;
+
+    state->serial_transfer_active = gb_serial_transfer_active;
+    state->serial_transfer_cycles = gb_serial_transfer_cycles;
+    state->serial_outgoing = gb_serial_outgoing;
+}
+
+void gb_load_state(const struct gb_state *state) {
+    memcpy(gb_memory, state->memory, sizeof(gb_memory));
+    gb_cpu = state->cpu;
+    gb_IME_flag = state->IME_flag;
+    gb_IME_flag_next = state->IME_flag_next;
+
+    memcpy(gb_obj_line_buffer, state->obj_line_buffer, sizeof(gb_obj_line_buffer));
+    memcpy(gb_win_line_buffer, state->win_line_buffer, sizeof(gb_win_line_buffer));
+    memcpy(gb_bg_line_buffer, state->bg_line_buffer, sizeof(gb_bg_line_buffer));
+    memcpy(gb_frame_buffer, state->frame_buffer, sizeof(gb_frame_buffer));
+    gb_mode = state->mode;
+    gb_scanlines = state->scanlines;
+    gb_scanline_dot_counter = state->scanline_dot_counter;
+    memcpy(gb_objects, state->objects, sizeof(gb_objects));
+    gb_obj_counter = state->obj_counter;
+
+    gb_joypad_buttons = state->joypad_buttons;
+    gb_frame_dot_counter = state->frame_dot_counter;
+
+    gb_serial_transfer_active = state->serial_transfer_active;
+    gb_serial_transfer_cycles = state->serial_transfer_cycles;
+    gb_serial_outgoing = state->serial_outgoing;
+    gb_watch_clear_events();
+}
+
+void gb_reset_emulator() {
+    struct gb_state *power_off = calloc(1, sizeof(struct gb_state));
+    gb_load_state(power_off);
+    free(power_off);
+    gb_opcode = 0;
+    gb_last_opcode = 0;
+    gb_instruction_counter = 0;
+    gb_total_M_cycles = 0;
+    gb_serial_output_length = 0;
+    gb_serial_output[0] = 0;
+}
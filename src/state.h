@@ -0,0 +1,44 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "emulator.h"
+#include "input.h"
+#include "watch.h"
+
+// Everything needed to resume emulation bit-identically. snapshot.h keeps
+// the same fields, update both.
+struct gb_state {
+    uint8_t memory[0x10000];
+    struct cpu cpu;
+    int IME_flag;
+    int IME_flag_next;
+
+    uint8_t obj_line_buffer[176];
+    uint8_t win_line_buffer[176];
+    uint8_t bg_line_buffer[176];
+    uint8_t frame_buffer[SCR_HEIGHT][SCR_WIDTH];
+    uint8_t mode;
+    uint8_t scanlines;
+    uint16_t scanline_dot_counter;
+    struct object objects[10];
+    uint8_t obj_counter;
+
+    uint8_t joypad_buttons;
+    int frame_dot_counter;
+
+    bool serial_transfer_active;
+    int serial_transfer_cycles;
+    uint8_t serial_outgoing;
+};
+
+void gb_save_state(struct gb_state *state);
+
+void gb_load_state(const struct gb_state *state);
+
+// Back to power-off, all memory and registers zeroed. Used when several
+// runs share one process.
+void gb_reset_emulator();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "hosttime.h"
+#include "emulator.h"
+#include "state.h"
+#include "workers.h"
+
+// Headless test ROM runner. Runs every ROM given (or found in the given
+// directories) with a cycle budget, in parallel worker processes, and
+// detects the result from:
+//   - serial output containing "Passed" or "Failed" (blargg)
+//   - LD B,B with B,C,D,E,H,L = 3,5,8,13,21,34 or all 0x42 (Mooneye)
+//   - the frame buffer hash matching the one in <rom>.hash
+// <rom>.cycles overrides the M-cycle budget for a single ROM.
+
+#define MAX_TEST_ROMS 4096
+#define DEFAULT_TEST_BUDGET (60 * 1048576ULL) // One emulated minute
+
+enum test_result {
+    TEST_PASSED,
+    TEST_FAILED,
+    TEST_TIMEOUT,
+    TEST_ERROR
+};
+
+const char *test_result_names[] = {"PASS", "FAIL", "TIMEOUT", "ERROR"};
+
+struct test_outcome {
+    enum test_result result;
+    char detected_by[16];
+    uint64_t M_cycles;
+    uint64_t frames;
+    double host_ms;
+    char serial_tail[48];
+};
+
+char *rom_paths[MAX_TEST_ROMS];
+int rom_count = 0;
+uint64_t default_budget = DEFAULT_TEST_BUDGET;
+
+bool has_rom_extension(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot && (strcmp(dot, ".gb") == 0 || strcmp(dot, ".gbc") == 0);
+}
+
+void add_rom(const char *path) {
+    if (rom_count < MAX_TEST_ROMS)
+        rom_paths[rom_count++] = strdup(path);
+}
+
+// Adds path if it is a ROM, or the ROMs below it if it is a directory
+void collect_roms(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        add_rom(path);
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        char child[1024];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        DIR *sub = opendir(child);
+        if (sub != NULL) {
+            closedir(sub);
+            collect_roms(child);
+        }
+        else if (has_rom_extension(entry->d_name)) {
+            add_rom(child);
+        }
+    }
+    closedir(dir);
+}
+
+int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// Reads a single hex or decimal number from <rom><suffix>
+bool read_sidecar(const char *rom, const char *suffix, const char *format, unsigned long long *value) {
+    char path[1100];
+    snprintf(path, sizeof(path), "%s%s", rom, suffix);
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    bool found = fscanf(file, format, value) == 1;
+    fclose(file);
+    return found;
+}
+
+bool mooneye_signature(uint8_t value_b, uint8_t value_c, uint8_t value_d, uint8_t value_e, uint8_t value_h, uint8_t value_l) {
+    return gb_cpu.B == value_b && gb_cpu.C == value_c && gb_cpu.D == value_d
+        && gb_cpu.E == value_e && gb_cpu.H == value_h && gb_cpu.L == value_l;
+}
+
+void finish_outcome(struct test_outcome *outcome, enum test_result result, const char *detected_by) {
+    outcome->result = result;
+    snprintf(outcome->detected_by, sizeof(outcome->detected_by), "%s", detected_by);
+}
+
+void run_test_rom(const char *path, struct test_outcome *outcome) {
+    memset(outcome, 0, sizeof(*outcome));
+    uint64_t start = gb_host_time_ns();
+
+    if (!gb_init_memory((char *)path)) {
+        finish_outcome(outcome, TEST_ERROR, "load");
+        return;
+    }
+    gb_init_cpu_registers();
+
+    unsigned long long budget = default_budget;
+    unsigned long long expected_hash = 0;
+    read_sidecar(path, ".cycles", "%llu", &budget);
+    bool check_hash = read_sidecar(path, ".hash", "%llx", &expected_hash);
+
+    int serial_checked = 0;
+    outcome->result = TEST_TIMEOUT;
+    snprintf(outcome->detected_by, sizeof(outcome->detected_by), "budget");
+    while (gb_total_M_cycles < budget && outcome->result == TEST_TIMEOUT) {
+        bool breakpoint = gb_memory[gb_cpu.PC] == 0x40; // LD B,B
+        gb_step_instruction();
+
+        if (breakpoint) {
+            if (mooneye_signature(3, 5, 8, 13, 21, 34))
+                finish_outcome(outcome, TEST_PASSED, "mooneye");
+            else if (mooneye_signature(0x42, 0x42, 0x42, 0x42, 0x42, 0x42))
+                finish_outcome(outcome, TEST_FAILED, "mooneye");
+        }
+        if (gb_serial_output_length != serial_checked) {
+            serial_checked = gb_serial_output_length;
+            if (strstr((char *)gb_serial_output, "Passed"))
+                finish_outcome(outcome, TEST_PASSED, "serial");
+            else if (strstr((char *)gb_serial_output, "Failed"))
+                finish_outcome(outcome, TEST_FAILED, "serial");
+        }
+        if (gb_frame_dot_counter >= gb_total_dots_per_frame) {
+            gb_frame_dot_counter = 0;
+            outcome->frames++;
+            if (check_hash && gb_xxh64(gb_frame_buffer, sizeof(gb_frame_buffer), 0) == expected_hash)
+                finish_outcome(outcome, TEST_PASSED, "frame hash");
+        }
+    }
+
+    outcome->M_cycles = gb_total_M_cycles;
+    outcome->host_ms = (gb_host_time_ns() - start) / 1e6;
+    // Keep the last line of serial output, it usually holds the verdict
+    int tail = gb_serial_output_length;
+    while (tail > 0 && (gb_serial_output[tail-1] == '\n' || gb_serial_output[tail-1] == ' '))
+        tail--;
+    int line_start = tail;
+    while (line_start > 0 && gb_serial_output[line_start-1] != '\n' && tail - line_start < (int)sizeof(outcome->serial_tail) - 1)
+        line_start--;
+    memcpy(outcome->serial_tail, gb_serial_output + line_start, tail - line_start);
+    outcome->serial_tail[tail - line_start] = 0;
+}
+
+void run_test_task(int index, void *result) {
+    run_test_rom(rom_paths[index], result);
+}
+
+int main(int argc, char *argv[]) {
+    int jobs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i+1 < argc)
+            jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cycles") == 0 && i+1 < argc)
+            default_budget = strtoull(argv[++i], NULL, 10);
+        else
+            collect_roms(argv[i]);
+    }
+    if (rom_count == 0) {
+        fprintf(stderr, "usage: test_runner [-j jobs] [--cycles M-cycles] rom-or-directory...\n");
+        return 1;
+    }
+    if (jobs <= 0)
+        jobs = default_job_count();
+    qsort(rom_paths, rom_count, sizeof(char *), compare_paths);
+
+    struct test_outcome *outcomes = calloc(rom_count, sizeof(struct test_outcome));
+    bool *crashed = calloc(rom_count, sizeof(bool));
+    uint64_t start = gb_host_time_ns();
+    run_workers(rom_count, jobs, run_test_task, outcomes, sizeof(struct test_outcome), crashed);
+    double total_seconds = (gb_host_time_ns() - start) / 1e9;
+
+    int counts[4] = {0};
+    printf("%-48s %-7s %-10s %12s %8s %10s  %s\n", "ROM", "result", "detected", "M-cycles", "frames", "host ms", "serial");
+    for (int i = 0; i < rom_count; i++) {
+        struct test_outcome *o = &outcomes[i];
+        if (crashed[i])
+            finish_outcome(o, TEST_ERROR, "crashed");
+        const char *name = rom_paths[i];
+        if (strlen(name) > 48)
+            name += strlen(name) - 48;
+        printf("%-48s %-7s %-10s %12llu %8llu %10.1f  %s\n", name, test_result_names[o->result], o->detected_by,
+            (unsigned long long)o->M_cycles, (unsigned long long)o->frames, o->host_ms, o->serial_tail);
+        counts[o->result]++;
+    }
+    printf("\n%d passed, %d failed, %d timed out, %d errors in %.2fs with %d jobs\n",
+        counts[TEST_PASSED], counts[TEST_FAILED], counts[TEST_TIMEOUT], counts[TEST_ERROR], total_seconds, jobs);
+    return counts[TEST_PASSED] == rom_count ? 0 : 1;
+}
\ No newline at end of file
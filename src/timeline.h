@@ -0,0 +1,155 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hosttime.h"
+#include "emulator.h"
+
+// Frame phase timeline exported as Chrome trace-event JSON, which loads in
+// chrome://tracing and ui.perfetto.dev. Events go into a ring allocated up
+// front, so the newest events are kept when it fills up. The emulation
+// and main threads can both add events.
+
+#define DEFAULT_TIMELINE_EVENTS (1 << 18)
+
+enum timeline_phase {
+    // Emulation track
+    PHASE_INPUT,
+    PHASE_EMULATE,
+    PHASE_AUDIO_PUSH,
+    PHASE_PACING_WAIT,
+    // Presentation track
+    PHASE_FRAME,
+    PHASE_TEXTURE_UPLOAD,
+    PHASE_RENDER,
+    PHASE_PRESENT,
+    // Per-frame estimates from gb_step_instruction_timed, laid end to end from the
+    // start of the emulate phase on their own track
+    PHASE_CPU,
+    PHASE_INTERRUPTS,
+    PHASE_PPU,
+    PHASE_COUNT
+};
+
+const char *timeline_phase_names[PHASE_COUNT] = {
+    "input", "emulate", "audio push", "pacing wait", "frame", "texture upload", "render", "present",
+    "cpu_execute", "handle_interrupts", "ppu_execute"
+};
+
+struct timeline_event {
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint32_t frame;
+    uint8_t phase;
+};
+
+bool timeline_enabled = false;
+bool timeline_subsystems = false; // Split emulate phases with gb_run_frame_timed
+char *timeline_path = NULL;
+struct timeline_event *timeline_events = NULL;
+_Atomic uint64_t timeline_event_count = 0;
+uint32_t timeline_capacity = 0;
+uint32_t timeline_frame = 0;
+uint64_t timeline_start_ns = 0;
+volatile sig_atomic_t timeline_dump_requested = 0;
+
+#ifndef _WIN32
+void request_timeline_dump(int sig) {
+    timeline_dump_requested = 1;
+}
+#endif
+
+// Allocates room for the given number of events. On POSIX, SIGUSR1 asks
+// for the timeline to be written at the end of the current frame.
+bool timeline_init(char *path, uint32_t capacity) {
+    timeline_events = malloc((size_t)capacity * sizeof(struct timeline_event));
+    if (timeline_events == NULL) {
+        fprintf(stderr, "Could not allocate %u timeline events\n", capacity);
+        return false;
+    }
+    timeline_path = path;
+    timeline_capacity = capacity;
+    timeline_start_ns = gb_host_time_ns();
+    timeline_enabled = true;
+#ifndef _WIN32
+    signal(SIGUSR1, request_timeline_dump);
+#endif
+    return true;
+}
+
+uint64_t timeline_begin() {
+    return timeline_enabled ? gb_host_time_ns() : 0;
+}
+
+void timeline_add(enum timeline_phase phase, uint64_t start_ns, uint64_t duration_ns) {
+    uint64_t index = atomic_fetch_add_explicit(&timeline_event_count, 1, memory_order_relaxed);
+    struct timeline_event *event = &timeline_events[index % timeline_capacity];
+    event->start_ns = start_ns;
+    event->duration_ns = duration_ns;
+    event->frame = timeline_frame;
+    event->phase = phase;
+}
+
+// Records a phase that started at the time returned by timeline_begin
+void timeline_end(enum timeline_phase phase, uint64_t start_ns) {
+    if (timeline_enabled)
+        timeline_add(phase, start_ns, gb_host_time_ns() - start_ns);
+}
+
+void timeline_add_subsystems(uint64_t emulate_start_ns, struct subsystem_times *times) {
+    gb_subtract_clock_overhead(times);
+    uint64_t start = emulate_start_ns;
+    timeline_add(PHASE_CPU, start, times->cpu_ns);
+    start += times->cpu_ns;
+    timeline_add(PHASE_INTERRUPTS, start, times->interrupts_ns);
+    start += times->interrupts_ns;
+    timeline_add(PHASE_PPU, start, times->ppu_ns);
+}
+
+int timeline_track(uint8_t phase) {
+    if (phase >= PHASE_CPU)
+        return 2;
+    return phase >= PHASE_FRAME ? 3 : 1;
+}
+
+bool write_timeline() {
+    FILE *out = fopen(timeline_path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Could not write timeline %s\n", timeline_path);
+        return false;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"emulation\"}},\n");
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"emulate breakdown\"}},\n");
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,\"args\":{\"name\":\"presentation\"}}");
+    uint64_t count = atomic_load(&timeline_event_count);
+    uint64_t first = count > timeline_capacity ? count - timeline_capacity : 0;
+    for (uint64_t i = first; i < count; i++) {
+        struct timeline_event *event = &timeline_events[i % timeline_capacity];
+        fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+            timeline_phase_names[event->phase], timeline_track(event->phase),
+            (event->start_ns - timeline_start_ns) / 1e3, event->duration_ns / 1e3, event->frame);
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    return true;
+}
+
+// Called once per emulated frame
+void timeline_next_frame() {
+    timeline_frame++;
+    if (timeline_dump_requested) {
+        timeline_dump_requested = 0;
+        if (write_timeline())
+            fprintf(stderr, "Wrote timeline to %s\n", timeline_path);
+    }
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracer.h"
+
+// Converts a binary trace dump into the gameboy-doctor log format.
+// With --cycles the M-cycle stamp is appended to every line.
+
+int main(int argc, char *argv[]) {
+    char *trace_path = NULL;
+    bool print_cycles = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cycles") == 0)
+            print_cycles = true;
+        else
+            trace_path = argv[i];
+    }
+    if (trace_path == NULL) {
+        fprintf(stderr, "usage: trace_decode [--cycles] trace.bin > trace.log\n");
+        return 1;
+    }
+
+    FILE *file = fopen(trace_path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open %s!\n", trace_path);
+        return 1;
+    }
+
+    struct trace_file_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, 4) != 0
+        || header.version != TRACE_VERSION || header.record_size != sizeof(struct trace_record)) {
+        fprintf(stderr, "%s is not a compatible trace dump!\n", trace_path);
+        fclose(file);
+        return 1;
+    }
+
+    // Decoded logs carry no instruction index, so --compare would read this
+    // one from the start of the run
+    if (header.first_record)
+        fprintf(stderr, "%s starts at instruction %llu, the trace ring had wrapped\n",
+            trace_path, (unsigned long long)header.first_record);
+
+    struct trace_record records[4096];
+    uint32_t remaining = header.record_count;
+    while (remaining > 0) {
+        size_t batch = remaining < 4096 ? remaining : 4096;
+        size_t read = fread(records, sizeof(struct trace_record), batch, file);
+        for (size_t i = 0; i < read; i++) {
+            char line[128];
+            gb_format_doctor_line(line, sizeof(line), &records[i]);
+            if (print_cycles)
+                printf("%s CY:%llu\n", line, (unsigned long long)records[i].cycle);
+            else
+                puts(line);
+        }
+        if (read < batch) {
+            fprintf(stderr, "%s is truncated!\n", trace_path);
+            break;
+        }
+        remaining -= read;
+    }
+    fclose(file);
+    return 0;
+}
\ No newline at end of file
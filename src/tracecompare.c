@@ -0,0 +1,238 @@
+#include "tracecompare.h"
+
+bool gb_trace_compare_enabled = false;
+bool gb_trace_compare_diverged = false;
+static struct mapped_file reference_file;
+static const char *reference_pos;
+static const char *reference_end;
+static bool reference_binary = false;
+static uint64_t compared_instructions = 0; // Counts the skipped ones too
+static uint64_t reference_first = 0;
+static struct trace_record expected_context[TRACE_COMPARE_CONTEXT];
+static struct trace_record actual_context[TRACE_COMPARE_CONTEXT];
+static int8_t hex_digit_values[256];
+
+static bool map_file(const char *path, struct mapped_file *mapped) {
+#ifdef _WIN32
+    mapped->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mapped->file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(mapped->file, &size);
+    mapped->size = (size_t)size.QuadPart;
+    mapped->mapping = CreateFileMappingA(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapped->mapping == NULL) {
+        CloseHandle(mapped->file);
+        return false;
+    }
+    mapped->data = MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+    return mapped->data != NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    fstat(fd, &st);
+    mapped->size = st.st_size;
+    void *data = mmap(NULL, mapped->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    madvise(data, mapped->size, MADV_SEQUENTIAL);
+    mapped->data = data;
+    return true;
+#endif
+}
+
+static void unmap_file(struct mapped_file *mapped) {
+    if (mapped->data == NULL)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapped->data);
+    CloseHandle(mapped->mapping);
+    CloseHandle(mapped->file);
+#else
+    munmap((void *)mapped->data, mapped->size);
+#endif
+    mapped->data = NULL;
+}
+
+bool gb_trace_compare_init(const char *path) {
+    if (!map_file(path, &reference_file) || reference_file.size == 0) {
+        printf("Could not map reference trace %s!\n", path);
+        return false;
+    }
+    reference_pos = reference_file.data;
+    reference_end = reference_file.data + reference_file.size;
+
+    reference_binary = reference_file.size >= sizeof(struct trace_file_header)
+        && memcmp(reference_file.data, TRACE_MAGIC, 4) == 0;
+    if (reference_binary) {
+        struct trace_file_header header;
+        memcpy(&header, reference_file.data, sizeof(header));
+        if (header.version != TRACE_VERSION || header.record_size != sizeof(struct trace_record)) {
+            printf("%s is not a compatible trace dump!\n", path);
+            unmap_file(&reference_file);
+            return false;
+        }
+        reference_pos += sizeof(header);
+        // A dump from a wrapped ring starts later in the run
+        reference_first = header.first_record;
+        if (reference_first)
+            printf("Reference trace %s starts at instruction %llu\n", path, (unsigned long long)reference_first);
+    }
+    else
+        reference_first = 0;
+
+    memset(hex_digit_values, -1, sizeof(hex_digit_values));
+    for (int i = 0; i < 10; i++)
+        hex_digit_values['0' + i] = i;
+    for (int i = 0; i < 6; i++) {
+        hex_digit_values['A' + i] = 10 + i;
+        hex_digit_values['a' + i] = 10 + i;
+    }
+
+    compared_instructions = 0;
+    gb_trace_compare_diverged = false;
+    gb_trace_compare_enabled = true;
+    return true;
+}
+
+// Parses digits hex digits at p, returns -1 if any of them isn't hex
+static int parse_hex(const char *p, int digits) {
+    int value = 0;
+    for (int i = 0; i < digits; i++) {
+        int digit = hex_digit_values[(uint8_t)p[i]];
+        if (digit < 0)
+            return -1;
+        value = (value << 4) | digit;
+    }
+    return value;
+}
+
+// The doctor format has fixed columns, so fields are read at fixed offsets
+static bool parse_doctor_line(const char *line, size_t length, struct trace_record *record) {
+    static const int byte_offsets[8] = {2, 7, 12, 17, 22, 27, 32, 37};
+    static const int pcmem_offsets[4] = {62, 65, 68, 71};
+    uint8_t *registers[8] = {&record->a, &record->f, &record->b, &record->c,
+                             &record->d, &record->e, &record->h, &record->l};
+
+    if (length < DOCTOR_LINE_LENGTH || line[0] != 'A' || line[40] != 'S' || line[48] != 'P' || line[56] != 'P')
+        return false;
+
+    memset(record, 0, sizeof(*record));
+    for (int i = 0; i < 8; i++) {
+        int value = parse_hex(line + byte_offsets[i], 2);
+        if (value < 0)
+            return false;
+        *registers[i] = value;
+    }
+    for (int i = 0; i < 4; i++) {
+        int value = parse_hex(line + pcmem_offsets[i], 2);
+        if (value < 0)
+            return false;
+        record->pcmem[i] = value;
+    }
+    int sp = parse_hex(line + 43, 4);
+    int pc = parse_hex(line + 51, 4);
+    if (sp < 0 || pc < 0)
+        return false;
+    record->sp = sp;
+    record->pc = pc;
+    return true;
+}
+
+// Returns 1 with the next reference state, 0 at the end of the file and -1
+// on a line that can't be parsed
+static int next_reference_record(struct trace_record *record) {
+    if (reference_binary) {
+        if (reference_end - reference_pos < (ptrdiff_t)sizeof(struct trace_record))
+            return 0;
+        memcpy(record, reference_pos, sizeof(struct trace_record));
+        reference_pos += sizeof(struct trace_record);
+        return 1;
+    }
+
+    while (reference_pos < reference_end && (*reference_pos == '\n' || *reference_pos == '\r'))
+        reference_pos++;
+    if (reference_pos >= reference_end)
+        return 0;
+
+    const char *line_end = memchr(reference_pos, '\n', reference_end - reference_pos);
+    if (line_end == NULL)
+        line_end = reference_end;
+    const char *line = reference_pos;
+    reference_pos = line_end;
+    if (!parse_doctor_line(line, line_end - line, record)) {
+        printf("Unparseable reference line after %llu instructions: %.*s\n",
+            (unsigned long long)compared_instructions, (int)(line_end - line), line);
+        return -1;
+    }
+    return 1;
+}
+
+static bool records_match(const struct trace_record *expected, const struct trace_record *actual) {
+    // Cycle stamps only exist in binary references
+    if (reference_binary && expected->cycle != actual->cycle)
+        return false;
+    return expected->pc == actual->pc && expected->sp == actual->sp
+        && expected->a == actual->a && expected->f == actual->f
+        && expected->b == actual->b && expected->c == actual->c
+        && expected->d == actual->d && expected->e == actual->e
+        && expected->h == actual->h && expected->l == actual->l
+        && memcmp(expected->pcmem, actual->pcmem, 4) == 0;
+}
+
+static void print_context_line(const char *label, const struct trace_record *record) {
+    char line[128];
+    gb_format_doctor_line(line, sizeof(line), record);
+    if (reference_binary)
+        printf("%s %s CY:%llu\n", label, line, (unsigned long long)record->cycle);
+    else
+        printf("%s %s\n", label, line);
+}
+
+static void report_divergence() {
+    printf("Trace diverged at instruction %llu\n", (unsigned long long)compared_instructions);
+    uint64_t first = compared_instructions > TRACE_COMPARE_CONTEXT ? compared_instructions - TRACE_COMPARE_CONTEXT : 0;
+    if (first < reference_first)
+        first = reference_first;
+    for (uint64_t i = first; i < compared_instructions; i++) {
+        int slot = i % TRACE_COMPARE_CONTEXT;
+        if (i + 1 == compared_instructions) {
+            print_context_line("expected:", &expected_context[slot]);
+            print_context_line("actual:  ", &actual_context[slot]);
+        }
+        else {
+            print_context_line("         ", &actual_context[slot]);
+        }
+    }
+}
+
+void gb_compare_instruction(uint16_t opcode, uint64_t cycle) {
+    if (compared_instructions < reference_first) {
+        compared_instructions++;
+        return;
+    }
+    int slot = compared_instructions % TRACE_COMPARE_CONTEXT;
+    int status = next_reference_record(&expected_context[slot]);
+    if (status <= 0) {
+        if (status == 0)
+            printf("Reference trace ended after %llu matching instructions\n", (unsigned long long)(compared_instructions - reference_first));
+        else
+            gb_trace_compare_diverged = true;
+        gb_trace_compare_enabled = false;
+        unmap_file(&reference_file);
+        return;
+    }
+
+    gb_capture_trace_record(&actual_context[slot], opcode, cycle);
+    compared_instructions++;
+    if (records_match(&expected_context[slot], &actual_context[slot]))
+        return;
+
+    report_divergence();
+    gb_trace_compare_diverged = true;
+    gb_trace_compare_enabled = false;
+    unmap_file(&reference_file);
+}
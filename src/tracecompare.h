@@ -0,0 +1,41 @@
+#ifndef TRACECOMPARE_H
+#define TRACECOMPARE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "tracer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Compares the CPU state before every instruction with a reference trace,
+// either a gameboy-doctor text log or a binary dump from the tracer. The
+// file is memory mapped and read front to back, nothing is materialized,
+// and comparison stops at the first divergence.
+
+#define TRACE_COMPARE_CONTEXT 8
+
+struct mapped_file {
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+extern bool gb_trace_compare_enabled;
+extern bool gb_trace_compare_diverged;
+
+bool gb_trace_compare_init(const char *path);
+
+// Called before every instruction while a comparison is running
+void gb_compare_instruction(uint16_t opcode, uint64_t cycle);
+
+#endif
\ No newline at end of file
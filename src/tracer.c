@@ -0,0 +1,114 @@
+#include "tracer.h"
+
+bool gb_tracer_enabled = false;
+static struct trace_record *trace_ring = NULL;
+static uint32_t trace_mask = 0;
+static _Atomic uint64_t trace_head = 0; // Number of records ever written
+char gb_trace_dump_path[512];
+
+void gb_write_all(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written <= 0)
+            return;
+        p += written;
+        size -= written;
+    }
+}
+
+void gb_tracer_dump() {
+    if (trace_ring == NULL)
+        return;
+    int fd = open(gb_trace_dump_path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    if (fd < 0)
+        return;
+
+    uint64_t head = atomic_load_explicit(&trace_head, memory_order_acquire);
+    uint64_t count = head < trace_mask + 1 ? head : trace_mask + 1;
+    uint64_t first = head - count;
+
+    struct trace_file_header header;
+    memcpy(header.magic, TRACE_MAGIC, 4);
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(struct trace_record);
+    header.record_count = (uint32_t)count;
+    header.first_record = first;
+    gb_write_all(fd, &header, sizeof(header));
+
+    // The ring may wrap, write the older half first
+    uint32_t start = first & trace_mask;
+    uint32_t until_end = trace_mask + 1 - start;
+    if (count <= until_end) {
+        gb_write_all(fd, &trace_ring[start], count * sizeof(struct trace_record));
+    }
+    else {
+        gb_write_all(fd, &trace_ring[start], until_end * sizeof(struct trace_record));
+        gb_write_all(fd, trace_ring, (count - until_end) * sizeof(struct trace_record));
+    }
+    close(fd);
+}
+
+static void trace_crash_handler(int signal_number) {
+    gb_tracer_dump();
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+bool gb_tracer_init(const char *dump_path, uint32_t record_count) {
+    if (record_count == 0 || record_count > MAX_TRACE_RECORDS) {
+        printf("Trace ring size must be from 1 to %d records!\n", MAX_TRACE_RECORDS);
+        return false;
+    }
+    uint32_t size = 1;
+    while (size * 2 <= record_count)
+        size *= 2;
+
+    trace_ring = calloc(size, sizeof(struct trace_record));
+    if (trace_ring == NULL) {
+        printf("Could not allocate trace ring of %u records!\n", size);
+        return false;
+    }
+    trace_mask = size - 1;
+    snprintf(gb_trace_dump_path, sizeof(gb_trace_dump_path), "%s", dump_path);
+    atomic_store(&trace_head, 0);
+
+    signal(SIGSEGV, trace_crash_handler);
+    signal(SIGABRT, trace_crash_handler);
+    signal(SIGILL, trace_crash_handler);
+    signal(SIGFPE, trace_crash_handler);
+    gb_tracer_enabled = true;
+    return true;
+}
+
+void gb_capture_trace_record(struct trace_record *record, uint16_t opcode, uint64_t cycle) {
+    record->cycle = cycle;
+    record->pc = gb_cpu.PC;
+    record->sp = gb_cpu.SP;
+    record->opcode = opcode;
+    record->a = gb_cpu.A;
+    record->f = gb_cpu.F;
+    record->b = gb_cpu.B;
+    record->c = gb_cpu.C;
+    record->d = gb_cpu.D;
+    record->e = gb_cpu.E;
+    record->h = gb_cpu.H;
+    record->l = gb_cpu.L;
+    record->pcmem[0] = gb_memory[gb_cpu.PC];
+    record->pcmem[1] = gb_memory[(uint16_t)(gb_cpu.PC+1)];
+    record->pcmem[2] = gb_memory[(uint16_t)(gb_cpu.PC+2)];
+    record->pcmem[3] = gb_memory[(uint16_t)(gb_cpu.PC+3)];
+    record->ime = gb_IME_flag;
+}
+
+int gb_format_doctor_line(char *out, size_t size, const struct trace_record *r) {
+    return snprintf(out, size, "A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X PC:%04X PCMEM:%02X,%02X,%02X,%02X",
+        r->a, r->f, r->b, r->c, r->d, r->e, r->h, r->l, r->sp, r->pc,
+        r->pcmem[0], r->pcmem[1], r->pcmem[2], r->pcmem[3]);
+}
+
+void gb_trace_instruction(uint16_t opcode, uint64_t cycle) {
+    uint64_t head = atomic_load_explicit(&trace_head, memory_order_relaxed);
+    gb_capture_trace_record(&trace_ring[head & trace_mask], opcode, cycle);
+    atomic_store_explicit(&trace_head, head + 1, memory_order_release);
+}
@@ -0,0 +1,71 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "cpu.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// Binary instruction trace kept in a fixed-size ring. The emulation thread
+// is the only writer, it publishes each record by advancing trace_head.
+// Dumps contain a trace_file_header followed by the records oldest first,
+// src/trace_decode.c turns them into gameboy-doctor logs. Once the ring has
+// wrapped, a dump only holds the most recent records.
+
+#define TRACE_MAGIC "GBTR"
+#define TRACE_VERSION 2
+#define DEFAULT_TRACE_RECORDS (1 << 20)
+#define MAX_TRACE_RECORDS (1 << 24) // 512 MiB of records
+
+// CPU state before the instruction at pc executes
+struct trace_record {
+    uint64_t cycle; // M-cycles since power on
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t opcode;
+    uint8_t a, f, b, c, d, e, h, l;
+    uint8_t pcmem[4];
+    uint8_t ime;
+    uint8_t reserved[5];
+};
+
+struct trace_file_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t record_count;
+    uint64_t first_record; // Instructions traced before the first record in the file
+};
+
+extern bool gb_tracer_enabled;
+extern char gb_trace_dump_path[512];
+
+void gb_write_all(int fd, const void *data, size_t size);
+
+// Only uses open/write so it can run from a signal handler
+void gb_tracer_dump();
+
+// record_count is rounded down to a power of two, it must be from 1 to
+// MAX_TRACE_RECORDS
+bool gb_tracer_init(const char *dump_path, uint32_t record_count);
+
+void gb_capture_trace_record(struct trace_record *record, uint16_t opcode, uint64_t cycle);
+
+#define DOCTOR_LINE_LENGTH 73
+
+// A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02
+int gb_format_doctor_line(char *out, size_t size, const struct trace_record *r);
+
+void gb_trace_instruction(uint16_t opcode, uint64_t cycle);
+
+#endif
\ No newline at end of file
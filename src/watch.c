@@ -0,0 +1,72 @@
+#include "watch.h"
+
+static struct watch watches[MAX_WATCHES];
+static uint8_t watched_pages[256 / 8]; // One bit per 256-byte page
+static struct watch_event watch_events[MAX_WATCH_EVENTS];
+static int watch_event_count = 0;
+int gb_watch_events_dropped = 0;
+
+bool gb_watched_page(uint16_t address) {
+    return watched_pages[address >> 11] & (1 << ((address >> 8) & 7));
+}
+
+static void update_watched_pages() {
+    memset(watched_pages, 0, sizeof(watched_pages));
+    for (int i = 0; i < MAX_WATCHES; i++) {
+        if (watches[i].active)
+            watched_pages[watches[i].address >> 11] |= 1 << ((watches[i].address >> 8) & 7);
+    }
+}
+
+int gb_watch_add(uint16_t address, enum watch_condition condition, uint8_t value) {
+    for (int i = 0; i < MAX_WATCHES; i++) {
+        if (!watches[i].active) {
+            watches[i] = (struct watch){true, condition, value, address};
+            update_watched_pages();
+            return i;
+        }
+    }
+    return -1;
+}
+
+void gb_watch_remove(int id) {
+    if (id < 0 || id >= MAX_WATCHES || !watches[id].active)
+        return;
+    watches[id].active = false;
+    update_watched_pages();
+}
+
+static bool watch_triggered(struct watch *watch, uint8_t old_value, uint8_t new_value) {
+    switch (watch->condition) {
+        case WATCH_CHANGES: return new_value != old_value;
+        case WATCH_EQUALS: return new_value == watch->value && old_value != watch->value;
+        case WATCH_CROSSES: return (old_value < watch->value) != (new_value < watch->value);
+        default: return false;
+    }
+}
+
+void gb_watch_write(uint16_t address, uint8_t old_value, uint8_t new_value) {
+    for (int i = 0; i < MAX_WATCHES; i++) {
+        struct watch *watch = &watches[i];
+        if (!watch->active || watch->address != address || !watch_triggered(watch, old_value, new_value))
+            continue;
+        if (watch_event_count == MAX_WATCH_EVENTS) {
+            gb_watch_events_dropped++;
+            continue;
+        }
+        watch_events[watch_event_count++] = (struct watch_event){i, address, old_value, new_value};
+    }
+}
+
+int gb_watch_take_events(struct watch_event *events, int max) {
+    int count = watch_event_count < max ? watch_event_count : max;
+    memcpy(events, watch_events, count * sizeof(struct watch_event));
+    watch_event_count -= count;
+    memmove(watch_events, watch_events + count, watch_event_count * sizeof(struct watch_event));
+    return count;
+}
+
+void gb_watch_clear_events() {
+    watch_event_count = 0;
+    gb_watch_events_dropped = 0;
+}
@@ -0,0 +1,61 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Address watches for scripts and agents reacting to game variables. They
+// are checked on bus writes (gb_write_to_memory) to pages with a watch, a
+// write elsewhere only tests one bit. Triggered events collect until the
+// caller takes them, normally once per frame. Stack pushes and DMA don't
+// go through the bus and aren't seen. The events aren't part of a save
+// state: loading one (netplay rollback, switching gbcore instances,
+// snapshot.h) drops those not yet taken, so they never come from a
+// discarded timeline or another instance, and frames run again after a
+// rollback report their writes again.
+
+#define MAX_WATCHES 64
+#define MAX_WATCH_EVENTS 1024
+
+enum watch_condition {
+    WATCH_CHANGES, // Any write of a different value
+    WATCH_EQUALS,  // The value becomes equal to value
+    WATCH_CROSSES  // The value moves from below value to value or above, or back
+};
+
+struct watch {
+    bool active;
+    uint8_t condition;
+    uint8_t value;
+    uint16_t address;
+};
+
+struct watch_event {
+    int watch;
+    uint16_t address;
+    uint8_t old_value;
+    uint8_t new_value;
+};
+
+extern int gb_watch_events_dropped;
+
+bool gb_watched_page(uint16_t address);
+
+// Returns the watch's id, or -1 when all are in use
+int gb_watch_add(uint16_t address, enum watch_condition condition, uint8_t value);
+
+// Ignores ids that aren't an active watch
+void gb_watch_remove(int id);
+
+// Called by the bus before a write to a watched page
+void gb_watch_write(uint16_t address, uint8_t old_value, uint8_t new_value);
+
+// Copies out and removes up to max of the oldest events. Events past
+// MAX_WATCH_EVENTS are counted in gb_watch_events_dropped instead.
+int gb_watch_take_events(struct watch_event *events, int max);
+
+// Drops the queued events and the dropped count, called when a state loads
+void gb_watch_clear_events();
+
+#endif
\ No newline at end of file
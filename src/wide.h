@@ -0,0 +1,343 @@
+#ifndef WIDE_H
+#define WIDE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "cpu.h"
+
+// Experimental lockstep interpreter for many instances of one ROM. The
+// registers of WIDE_LANES instances are stored as structure of arrays, and
+// lanes whose PC matches execute the opcode together as masked loops over
+// all lanes, which the compiler turns into SIMD (build with -O3). Lanes
+// share the ROM, so only PCs below 0x8000 run wide. Loads and stores run
+// wide when every lane's address is in WRAM or HRAM, which have no side
+// effects. Anything else runs one lane at a time through gb_cpu_execute, the
+// reference, with the lane swapped into the globals. The RAM of the last
+// lane swapped in stays in gb_memory[] until another lane needs it.
+//
+// Only the CPU is emulated: no PPU, interrupts or serial, so it suits
+// CPU-bound code and measuring how often lanes stay together.
+
+#define WIDE_LANES 16
+#define WIDE_RAM_SIZE 0x8000 // 0x8000-0xFFFF, per lane
+#define FOR_LANES for (int l = 0; l < WIDE_LANES; l++)
+
+struct wide_batch {
+    uint8_t A[WIDE_LANES], F[WIDE_LANES];
+    uint8_t B[WIDE_LANES], C[WIDE_LANES];
+    uint8_t D[WIDE_LANES], E[WIDE_LANES];
+    uint8_t H[WIDE_LANES], L[WIDE_LANES];
+    uint16_t SP[WIDE_LANES], PC[WIDE_LANES];
+    int IME_flag[WIDE_LANES], IME_flag_next[WIDE_LANES];
+    uint64_t M_cycles[WIDE_LANES];
+    uint8_t ram[WIDE_LANES][WIDE_RAM_SIZE];
+    int resident; // Lane whose RAM is in gb_memory[] instead of ram, -1 if none
+
+    uint64_t wide_instructions;   // Lane instructions executed wide
+    uint64_t scalar_instructions; // Lane instructions run through gb_cpu_execute
+    uint64_t groups;              // Wide executions, one per distinct PC per step
+};
+
+uint8_t *lane_ram(struct wide_batch *batch, int l) {
+    return l == batch->resident ? &gb_memory[0x8000] : batch->ram[l];
+}
+
+// Moves lane l's RAM into gb_memory[], writing back the previous lane's
+void make_resident(struct wide_batch *batch, int l) {
+    if (batch->resident == l)
+        return;
+    if (batch->resident >= 0)
+        memcpy(batch->ram[batch->resident], &gb_memory[0x8000], WIDE_RAM_SIZE);
+    memcpy(&gb_memory[0x8000], batch->ram[l], WIDE_RAM_SIZE);
+    batch->resident = l;
+}
+
+// Puts the resident lane's RAM back into ram, call before reading it
+void wide_flush(struct wide_batch *batch) {
+    if (batch->resident >= 0)
+        memcpy(batch->ram[batch->resident], &gb_memory[0x8000], WIDE_RAM_SIZE);
+    batch->resident = -1;
+}
+
+void store_registers(struct wide_batch *batch, int l) {
+    batch->A[l] = gb_cpu.A; batch->F[l] = gb_cpu.F;
+    batch->B[l] = gb_cpu.B; batch->C[l] = gb_cpu.C;
+    batch->D[l] = gb_cpu.D; batch->E[l] = gb_cpu.E;
+    batch->H[l] = gb_cpu.H; batch->L[l] = gb_cpu.L;
+    batch->SP[l] = gb_cpu.SP; batch->PC[l] = gb_cpu.PC;
+    batch->IME_flag[l] = gb_IME_flag;
+    batch->IME_flag_next[l] = gb_IME_flag_next;
+}
+
+void load_registers(struct wide_batch *batch, int l) {
+    gb_cpu.A = batch->A[l]; gb_cpu.F = batch->F[l];
+    gb_cpu.B = batch->B[l]; gb_cpu.C = batch->C[l];
+    gb_cpu.D = batch->D[l]; gb_cpu.E = batch->E[l];
+    gb_cpu.H = batch->H[l]; gb_cpu.L = batch->L[l];
+    gb_cpu.SP = batch->SP[l]; gb_cpu.PC = batch->PC[l];
+    gb_IME_flag = batch->IME_flag[l];
+    gb_IME_flag_next = batch->IME_flag_next[l];
+}
+
+// Copies the running emulator's CPU and RAM into a lane
+void wide_store_lane(struct wide_batch *batch, int l) {
+    wide_flush(batch);
+    store_registers(batch, l);
+    memcpy(batch->ram[l], &gb_memory[0x8000], WIDE_RAM_SIZE);
+}
+
+void wide_load_lane(struct wide_batch *batch, int l) {
+    wide_flush(batch);
+    load_registers(batch, l);
+    memcpy(&gb_memory[0x8000], batch->ram[l], WIDE_RAM_SIZE);
+}
+
+void wide_scalar_step(struct wide_batch *batch, int l) {
+    make_resident(batch, l);
+    load_registers(batch, l);
+    uint16_t opcode = gb_memory[gb_cpu.PC];
+    if (opcode == 0xCB)
+        opcode = (opcode << 8) | gb_memory[gb_cpu.PC+1];
+    batch->M_cycles[l] += gb_cpu_execute(opcode);
+    store_registers(batch, l);
+    batch->scalar_instructions++;
+}
+
+bool plain_ram(uint16_t address) {
+    return (address >= 0xC000 && address <= 0xDFFF) || (address >= 0xFF80 && address <= 0xFFFE);
+}
+
+// Per-lane addresses of a load or store, false if a masked lane's address
+// isn't plain RAM
+bool lane_addresses(struct wide_batch *batch, int opcode, uint16_t n16, const uint8_t *mask, uint16_t *addresses) {
+    bool plain = true;
+    FOR_LANES {
+        uint16_t address = (batch->H[l] << 8) | batch->L[l];
+        if (opcode == 0xEA || opcode == 0xFA)
+            address = n16;
+        else if (opcode == 0xE0 || opcode == 0xF0)
+            address = 0xFF00 + (n16 & 0xFF);
+        addresses[l] = address;
+        plain &= !mask[l] || plain_ram(address);
+    }
+    return plain;
+}
+
+uint8_t *wide_r8(struct wide_batch *batch, int index) {
+    uint8_t *regs[8] = {batch->B, batch->C, batch->D, batch->E, batch->H, batch->L, NULL, batch->A};
+    return regs[index];
+}
+
+// Flags like gb_cpu_execute, including its INC r8 half carry, which is never set
+void wide_inc_dec(struct wide_batch *batch, uint8_t *reg, const uint8_t *mask, bool dec) {
+    FOR_LANES {
+        uint8_t r8 = reg[l];
+        uint8_t result = dec ? r8 - 1 : r8 + 1;
+        uint8_t flags = batch->F[l] & ~(FLAG_Z | FLAG_N | FLAG_H);
+        if (dec)
+            flags = (batch->F[l] & ~(FLAG_Z | FLAG_H)) | FLAG_N | ((r8 & 0xF) == 0 ? FLAG_H : 0);
+        flags |= result == 0 ? FLAG_Z : 0;
+        reg[l] = mask[l] ? result : r8;
+        batch->F[l] = mask[l] ? flags : batch->F[l];
+    }
+}
+
+void wide_inc_dec16(uint8_t *high, uint8_t *low, const uint8_t *mask, int delta) {
+    FOR_LANES {
+        uint16_t value = ((high[l] << 8) | low[l]) + (mask[l] ? delta : 0);
+        high[l] = value >> 8;
+        low[l] = value & 0xFF;
+    }
+}
+
+// AND, XOR, OR, CP of A with a per-lane operand
+void wide_logic(struct wide_batch *batch, int operation, const uint8_t *operand, const uint8_t *mask) {
+    FOR_LANES {
+        uint8_t a = batch->A[l], n8 = operand[l];
+        uint8_t result = operation == 0 ? a & n8 : operation == 1 ? a ^ n8 : operation == 2 ? a | n8 : a;
+        uint8_t flags;
+        if (operation == 3)
+            flags = (a == n8 ? FLAG_Z : 0) | FLAG_N | ((a & 0xF) < (n8 & 0xF) ? FLAG_H : 0) | (a < n8 ? FLAG_C : 0);
+        else
+            flags = (result == 0 ? FLAG_Z : 0) | (operation == 0 ? FLAG_H : 0);
+        batch->A[l] = mask[l] ? result : a;
+        batch->F[l] = mask[l] ? flags : batch->F[l];
+    }
+}
+
+// Executes the opcode at pc on the masked lanes. Returns false, changing
+// nothing, if it isn't in the wide subset.
+bool wide_execute(struct wide_batch *batch, uint16_t pc, const uint8_t *mask) {
+    uint8_t opcode = gb_memory[pc];
+    uint8_t n8 = gb_memory[(uint16_t)(pc + 1)];
+    uint16_t n16 = (gb_memory[(uint16_t)(pc + 2)] << 8) | n8;
+    uint8_t operand[WIDE_LANES];
+    int length = 1, cycles = 1;
+    int taken_cycles = 0; // Conditional jumps: cycles when taken
+    uint16_t target = 0;
+    uint8_t condition[WIDE_LANES];
+    uint16_t addresses[WIDE_LANES];
+
+    bool store = (opcode >= 0x70 && opcode < 0x78 && opcode != 0x76) || opcode == 0xEA || opcode == 0xE0
+        || opcode == 0x22 || opcode == 0x32;
+    bool load = (opcode >= 0x40 && opcode < 0x80 && (opcode & 7) == 6 && opcode != 0x76) || opcode == 0xFA
+        || opcode == 0xF0 || opcode == 0x2A || opcode == 0x3A;
+    if ((store || load) && !lane_addresses(batch, opcode, n16, mask, addresses))
+        return false;
+
+    if (opcode == 0x00) {
+        // NOP
+    }
+    else if (store) {
+        // LD [HL],r8, LD [n16],A, LDH [n8],A, LD [HLI]/[HLD],A
+        uint8_t *source = opcode < 0x78 && opcode >= 0x70 ? wide_r8(batch, opcode - 0x70) : batch->A;
+        FOR_LANES {
+            if (mask[l])
+                lane_ram(batch, l)[addresses[l] - 0x8000] = source[l];
+        }
+        length = opcode == 0xEA ? 3 : opcode == 0xE0 ? 2 : 1;
+        cycles = opcode == 0xEA ? 4 : opcode == 0xE0 ? 3 : 2;
+    }
+    else if (load) {
+        // LD r8,[HL], LD A,[n16], LDH A,[n8], LD A,[HLI]/[HLD]
+        uint8_t *destination = opcode < 0x80 && opcode >= 0x40 ? wide_r8(batch, (opcode - 0x40) / 8) : batch->A;
+        FOR_LANES {
+            if (mask[l])
+                destination[l] = lane_ram(batch, l)[addresses[l] - 0x8000];
+        }
+        length = opcode == 0xFA ? 3 : opcode == 0xF0 ? 2 : 1;
+        cycles = opcode == 0xFA ? 4 : opcode == 0xF0 ? 3 : 2;
+    }
+    else if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76 && (opcode & 7) != 6 && ((opcode >> 3) & 7) != 6) {
+        // LD r8,r8
+        uint8_t *destination = wide_r8(batch, (opcode - 0x40) / 8);
+        uint8_t *source = wide_r8(batch, opcode % 8);
+        FOR_LANES destination[l] = mask[l] ? source[l] : destination[l];
+    }
+    else if ((opcode & 0xC7) == 0x06 && opcode != 0x36) {
+        // LD r8,n8
+        uint8_t *destination = wide_r8(batch, opcode >> 3);
+        FOR_LANES destination[l] = mask[l] ? n8 : destination[l];
+        length = 2;
+        cycles = 2;
+    }
+    else if ((opcode & 0xC7) == 0x04 && opcode != 0x34) {
+        wide_inc_dec(batch, wide_r8(batch, opcode >> 3), mask, false);
+    }
+    else if ((opcode & 0xC7) == 0x05 && opcode != 0x35) {
+        wide_inc_dec(batch, wide_r8(batch, opcode >> 3), mask, true);
+    }
+    else if ((opcode & 0xCF) == 0x01 || (opcode & 0xCF) == 0x03 || (opcode & 0xCF) == 0x0B) {
+        // LD r16,n16 and INC/DEC r16
+        int pair = opcode >> 4;
+        if (pair == 3) {
+            FOR_LANES {
+                uint16_t sp = opcode == 0x31 ? n16 : opcode == 0x33 ? batch->SP[l] + 1 : batch->SP[l] - 1;
+                batch->SP[l] = mask[l] ? sp : batch->SP[l];
+            }
+        }
+        else {
+            uint8_t *high = wide_r8(batch, pair * 2), *low = wide_r8(batch, pair * 2 + 1);
+            if ((opcode & 0xCF) == 0x01) {
+                FOR_LANES {
+                    high[l] = mask[l] ? n16 >> 8 : high[l];
+                    low[l] = mask[l] ? n16 & 0xFF : low[l];
+                }
+            }
+            else
+                wide_inc_dec16(high, low, mask, (opcode & 0xCF) == 0x03 ? 1 : -1);
+        }
+        length = (opcode & 0xCF) == 0x01 ? 3 : 1;
+        cycles = (opcode & 0xCF) == 0x01 ? 3 : 2;
+    }
+    else if (opcode >= 0xA0 && opcode < 0xC0 && (opcode & 7) != 6) {
+        // AND, XOR, OR, CP A,r8
+        wide_logic(batch, (opcode - 0xA0) / 8, wide_r8(batch, opcode % 8), mask);
+    }
+    else if (opcode == 0xE6 || opcode == 0xEE || opcode == 0xF6 || opcode == 0xFE) {
+        // AND, XOR, OR, CP A,n8
+        memset(operand, n8, sizeof(operand));
+        wide_logic(batch, (opcode - 0xE6) / 8, operand, mask);
+        length = 2;
+        cycles = 2;
+    }
+    else if (opcode == 0x2F) {
+        // CPL
+        FOR_LANES {
+            batch->A[l] = mask[l] ? ~batch->A[l] : batch->A[l];
+            batch->F[l] |= mask[l] ? FLAG_N | FLAG_H : 0;
+        }
+    }
+    else if (opcode == 0xC3 || opcode == 0x18) {
+        // JP n16, JR e8
+        target = opcode == 0xC3 ? n16 : pc + 2 + (int8_t)n8;
+        FOR_LANES batch->PC[l] = mask[l] ? target : batch->PC[l];
+        cycles = opcode == 0xC3 ? 4 : 3;
+        length = 0;
+    }
+    else if ((opcode & 0xE7) == 0x20 || (opcode & 0xE7) == 0xC2) {
+        // JR cc,e8 and JP cc,n16
+        uint8_t flag = opcode & 0x10 ? FLAG_C : FLAG_Z;
+        bool when_set = opcode & 0x08;
+        bool relative = (opcode & 0xC0) == 0;
+        target = relative ? pc + 2 + (int8_t)n8 : n16;
+        length = relative ? 2 : 3;
+        cycles = relative ? 2 : 3;
+        taken_cycles = relative ? 3 : 4;
+        FOR_LANES condition[l] = ((batch->F[l] & flag) != 0) == when_set;
+    }
+    else
+        return false;
+
+    if (opcode == 0x22 || opcode == 0x32 || opcode == 0x2A || opcode == 0x3A)
+        wide_inc_dec16(batch->H, batch->L, mask, opcode == 0x22 || opcode == 0x2A ? 1 : -1);
+
+    FOR_LANES {
+        if (taken_cycles) {
+            uint16_t next = condition[l] ? target : pc + length;
+            batch->PC[l] = mask[l] ? next : batch->PC[l];
+            batch->M_cycles[l] += mask[l] ? (condition[l] ? taken_cycles : cycles) : 0;
+        }
+        else {
+            batch->PC[l] += mask[l] ? length : 0;
+            batch->M_cycles[l] += mask[l] ? cycles : 0;
+        }
+
+        // Delayed IME enable, as at the end of gb_cpu_execute
+        int next = batch->IME_flag_next[l];
+        batch->IME_flag[l] = mask[l] && next == 2 ? 1 : batch->IME_flag[l];
+        batch->IME_flag_next[l] = mask[l] ? (next == 1 ? 2 : next == 2 ? 0 : next) : next;
+    }
+    return true;
+}
+
+// Executes one instruction on every lane
+void wide_step(struct wide_batch *batch) {
+    uint8_t done[WIDE_LANES] = {0};
+    uint8_t mask[WIDE_LANES];
+    for (int lane = 0; lane < WIDE_LANES; lane++) {
+        if (done[lane])
+            continue;
+        uint16_t pc = batch->PC[lane];
+        int count = 0;
+        FOR_LANES {
+            mask[l] = !done[l] && batch->PC[l] == pc;
+            count += mask[l];
+        }
+
+        if (pc < 0x8000 && wide_execute(batch, pc, mask)) {
+            batch->wide_instructions += count;
+            batch->groups++;
+        }
+        else {
+            FOR_LANES {
+                if (mask[l])
+                    wide_scalar_step(batch, l);
+            }
+        }
+        FOR_LANES done[l] |= mask[l];
+    }
+}
+
+#endif
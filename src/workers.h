@@ -0,0 +1,94 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "state.h"
+#include "tracer.h"
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+// Runs independent emulator tasks in parallel. The core lives in globals,
+// so each task gets its own forked process that starts from the parent's
+// untouched state and sends a fixed-size result back through a pipe.
+
+typedef void (*worker_task)(int index, void *result);
+
+int default_job_count() {
+#ifdef _WIN32
+    return 1;
+#else
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? cpus : 1;
+#endif
+}
+
+#ifdef _WIN32
+// No fork, run the tasks one after another from a clean state
+void run_workers(int count, int jobs, worker_task task, void *results, size_t result_size, bool *crashed) {
+    for (int i = 0; i < count; i++) {
+        gb_reset_emulator();
+        crashed[i] = false;
+        task(i, (char *)results + i * result_size);
+    }
+}
+#else
+// crashed[i] is set for tasks whose process died before reporting a result
+void run_workers(int count, int jobs, worker_task task, void *results, size_t result_size, bool *crashed) {
+    pid_t *pids = calloc(count, sizeof(pid_t));
+    int *pipes = calloc(count, sizeof(int));
+    int next = 0, running = 0, finished = 0;
+    fflush(stdout);
+
+    while (finished < count) {
+        while (running < jobs && next < count) {
+            int fds[2];
+            if (pipe(fds) != 0) {
+                perror("pipe");
+                exit(1);
+            }
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fds[0]);
+                void *result = calloc(1, result_size);
+                task(next, result);
+                gb_write_all(fds[1], result, result_size);
+                fflush(stdout);
+                _exit(0);
+            }
+            close(fds[1]);
+            pids[next] = pid;
+            pipes[next] = fds[0];
+            next++;
+            running++;
+        }
+
+        int status;
+        pid_t done = wait(&status);
+        if (done < 0)
+            break;
+        for (int i = 0; i < next; i++) {
+            if (pids[i] != done)
+                continue;
+            void *result = (char *)results + i * result_size;
+            size_t received = 0;
+            ssize_t got;
+            while (received < result_size && (got = read(pipes[i], (char *)result + received, result_size - received)) > 0)
+                received += got;
+            crashed[i] = received != result_size;
+            close(pipes[i]);
+            pids[i] = 0;
+            running--;
+            finished++;
+        }
+    }
+    free(pids);
+    free(pipes);
+}
+#endif
+
+#endif
\ No newline at end of file